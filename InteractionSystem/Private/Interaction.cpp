@@ -1,7 +1,8 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "Interaction.h"
-#include "Engine/OverlapResult.h"
+#include "EngineUtils.h"
+#include "Engine/Level.h"
 
 #include "Camera/CameraComponent.h"
 
@@ -9,42 +10,198 @@
 #include "GameplayAbilities/Public/Abilities/Tasks/AbilityTask_WaitInputRelease.h"
 #include "AbilitySystemGlobals.h"
 #include "GameplayCueManager.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StaticMesh.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/AutomationTest.h"
+#include "Engine/Engine.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Net/Core/PushModel/PushModel.h"
 
 DEFINE_LOG_CATEGORY(LogInteractionSystem)
+
+DECLARE_CYCLE_STAT(TEXT("GetInteractionTarget"), STAT_Interaction_GetInteractionTarget, STATGROUP_Interaction);
+DECLARE_CYCLE_STAT(TEXT("GatherCandidates"), STAT_Interaction_GatherCandidates, STATGROUP_Interaction);
+DECLARE_CYCLE_STAT(TEXT("ScoreCandidates"), STAT_Interaction_ScoreCandidates, STATGROUP_Interaction);
+DECLARE_CYCLE_STAT(TEXT("Hold validation"), STAT_Interaction_ValidateHoldTarget, STATGROUP_Interaction);
+DECLARE_CYCLE_STAT(TEXT("Hold completion"), STAT_Interaction_FinishHolding, STATGROUP_Interaction);
+DECLARE_CYCLE_STAT(TEXT("Outlining tick"), STAT_Interaction_OutliningTick, STATGROUP_Interaction);
+DECLARE_CYCLE_STAT(TEXT("GetWidget"), STAT_Interaction_GetWidget, STATGROUP_Interaction);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries"), STAT_Interaction_Queries, STATGROUP_Interaction);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Candidates"), STAT_Interaction_Candidates, STATGROUP_Interaction);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Line of sight traces"), STAT_Interaction_LineOfSightTraces, STATGROUP_Interaction);
+DECLARE_DWORD_COUNTER_STAT(TEXT("RPCs"), STAT_Interaction_RPCs, STATGROUP_Interaction);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active holds"), STAT_Interaction_ActiveHolds, STATGROUP_Interaction);
+DECLARE_CYCLE_STAT(TEXT("Arbitration"), STAT_Interaction_Arbitration, STATGROUP_Interaction);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rate limited requests"), STAT_Interaction_RateLimited, STATGROUP_Interaction);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Dormant interactables"), STAT_Interaction_DormantInteractables, STATGROUP_Interaction);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Awake interactables"), STAT_Interaction_AwakeInteractables, STATGROUP_Interaction);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dormancy wakes"), STAT_Interaction_DormancyWakes, STATGROUP_Interaction);
+
+CSV_DEFINE_CATEGORY(Interaction, true);
+
+//------------------------------------------------------------------------------------------------------------/InteractionStats/------------------------------------------------------------------------------------------------------------
+namespace InteractionStats
+{
+	static uint64 FrameNumber = 0;
+	static int32 QueriesThisFrame = 0;
+	static int32 HitsThisFrame = 0;
+	static int32 ActiveHolds = 0;
+	static int32 DormantInteractables = 0;
+	static int32 AwakeInteractables = 0;
+	static int32 RPCsThisSecond = 0;
+	static int32 RPCsLastSecond = 0;
+	static double SecondStartTime = 0.0;
+	// Never reset, the benchmark measures the difference around a case
+	static uint64 LineOfSightTraces = 0;
+
+	static void BeginFrameIfNeeded()
+	{
+		if (FrameNumber != GFrameCounter)
+		{
+			FrameNumber = GFrameCounter;
+			QueriesThisFrame = 0;
+			HitsThisFrame = 0;
+		}
+	}
+
+	static void RecordQuery(bool bFoundTarget)
+	{
+		BeginFrameIfNeeded();
+		++QueriesThisFrame;
+		if (bFoundTarget)
+			++HitsThisFrame;
+
+		INC_DWORD_STAT(STAT_Interaction_Queries);
+		CSV_CUSTOM_STAT(Interaction, QueriesPerFrame, 1, ECsvCustomStatOp::Accumulate);
+		CSV_CUSTOM_STAT(Interaction, InteractableHitRatio, static_cast<float>(HitsThisFrame) / QueriesThisFrame, ECsvCustomStatOp::Set);
+	}
+
+	static void RecordCandidates(int32 Candidates)
+	{
+		INC_DWORD_STAT_BY(STAT_Interaction_Candidates, Candidates);
+		CSV_CUSTOM_STAT(Interaction, CandidatesPerFrame, Candidates, ECsvCustomStatOp::Accumulate);
+	}
+
+	static void RecordLineOfSightTrace()
+	{
+		++LineOfSightTraces;
+		INC_DWORD_STAT(STAT_Interaction_LineOfSightTraces);
+		CSV_CUSTOM_STAT(Interaction, LineOfSightTracesPerFrame, 1, ECsvCustomStatOp::Accumulate);
+	}
+
+	static void RecordRPC()
+	{
+		++RPCsThisSecond;
+		INC_DWORD_STAT(STAT_Interaction_RPCs);
+	}
+
+	static void ChangeActiveHolds(int32 Delta)
+	{
+		ActiveHolds += Delta;
+		if (Delta > 0)
+			INC_DWORD_STAT_BY(STAT_Interaction_ActiveHolds, Delta);
+		else DEC_DWORD_STAT_BY(STAT_Interaction_ActiveHolds, -Delta);
+	}
+
+	static void ChangeNetDormancy(int32 DormantDelta, int32 AwakeDelta)
+	{
+		DormantInteractables += DormantDelta;
+		AwakeInteractables += AwakeDelta;
+		if (DormantDelta > 0)
+			INC_DWORD_STAT_BY(STAT_Interaction_DormantInteractables, DormantDelta);
+		else DEC_DWORD_STAT_BY(STAT_Interaction_DormantInteractables, -DormantDelta);
+		if (AwakeDelta > 0)
+			INC_DWORD_STAT_BY(STAT_Interaction_AwakeInteractables, AwakeDelta);
+		else DEC_DWORD_STAT_BY(STAT_Interaction_AwakeInteractables, -AwakeDelta);
+	}
+
+	static void RecordDormancyWake()
+	{
+		INC_DWORD_STAT(STAT_Interaction_DormancyWakes);
+		CSV_CUSTOM_STAT(Interaction, DormancyWakesPerFrame, 1, ECsvCustomStatOp::Accumulate);
+	}
+
+	/// <summary>
+	/// Records values which must be present in every frame of the CSV capture. Called once per frame.
+	/// </summary>
+	static void RecordFrame()
+	{
+		// Every world ticks its own subsystem
+		static uint64 lastRecordedFrame = 0;
+		if (lastRecordedFrame == GFrameCounter)
+			return;
+		lastRecordedFrame = GFrameCounter;
+
+		const double now = FPlatformTime::Seconds();
+		if (now - SecondStartTime >= 1.0)
+		{
+			RPCsLastSecond = RPCsThisSecond;
+			RPCsThisSecond = 0;
+			SecondStartTime = now;
+		}
+		CSV_CUSTOM_STAT(Interaction, ActiveHolds, ActiveHolds, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Interaction, RPCsPerSecond, RPCsLastSecond, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Interaction, DormantInteractables, DormantInteractables, ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Interaction, AwakeInteractables, AwakeInteractables, ECsvCustomStatOp::Set);
+	}
+}
 //------------------------------------------------------------------------------------------------------------/ActivateAbility/------------------------------------------------------------------------------------------------------------
 void UGAInteraction::ActivateAbility(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, const FGameplayEventData* TriggerEventData)
 {
 	Super::ActivateAbility(Handle, ActorInfo, ActivationInfo, TriggerEventData);
 
+	bInteractionPredicted = false;
+	HoldTimeCredit = 0.f;
+
 	if (ActorInfo && ActorInfo->AvatarActor.IsValid())
 	{
 		AvatarActor = ActorInfo->AvatarActor.Get();
-		TargetActor = GetInteractionTarget(AvatarActor);
 
+		// Locally controlled avatar without a player, e.g. a server-side bot, has no widget
 		if (IsLocallyControlled())
-			InteractionSubsystem = AvatarActor->GetInstigatorController<APlayerController>()->GetLocalPlayer()->GetSubsystem<UInteractionLocalPlayerSubsystem>();
+			if (APlayerController* playerController = AvatarActor->GetInstigatorController<APlayerController>())
+				if (ULocalPlayer* localPlayer = playerController->GetLocalPlayer())
+					InteractionSubsystem = localPlayer->GetSubsystem<UInteractionLocalPlayerSubsystem>();
+
+		// Activation of a remote player`s ability is caused by an RPC
+		if (HasAuthority(&ActivationInfo) && !IsLocallyControlled())
+			InteractionStats::RecordRPC();
 
-		if (TargetActor)
+		if (GetNetExecutionPolicy() == EGameplayAbilityNetExecutionPolicy::LocalPredicted && HasAuthority(&ActivationInfo) && !IsLocallyControlled())
 		{
-			//=====================================================================================================/Implementation of different interaction types/=====================================================================================================
-			switch (IInteractable::Execute_GetInteractionType(TargetActor))
-			{	//----------------------------------------------------------------------------------------------------------------------------------------------/ Press
-			case EInteractionType::Press:
-				// any interaction logic for other types can be added here
-				ExecuteInteraction(&ActivationInfo);
-				EndAbility(Handle, ActorInfo, ActivationInfo, false, false);
-				break;
-				//----------------------------------------------------------------------------------------------------------------------------------------------/ Hold
-			case EInteractionType::Hold:
-				HoldImplementanion(Handle, ActorInfo, ActivationInfo, TriggerEventData);
-				break;
-				//----------------------------------------------------------------------------------------------------------------------------------------------/ Uknown
-			default:
-				UE_LOG(LogInteractionSystem, Warning, TEXT("GAInteraction: Uknown interaction type. Update interaction gameplay ability"));
-				EndAbility(Handle, ActorInfo, ActivationInfo, false, false);
-				break;
-			}//=========================================================================================================================================================================================================================================================
+			// Target is chosen by the predicting client and validated when its target data arrives
+			UAbilitySystemComponent* asc = ActorInfo->AbilitySystemComponent.Get();
+			ClientTargetDataDelegateHandle = asc->AbilityTargetDataSetDelegate(Handle, ActivationInfo.GetActivationPredictionKey()).AddUObject(this, &UGAInteraction::OnClientTargetDataReceived);
+			asc->CallReplicatedTargetDataDelegatesIfSet(Handle, ActivationInfo.GetActivationPredictionKey());
+			return;
+		}
+
+		// Server decides through the arbiter, which batches targeting of the frame and resolves contention
+		if (HasAuthority(&ActivationInfo) && SubmitToArbiter(FInteractableHandle()))
+			return;
+
+		InteractionTarget = GetCachedInteractionTarget(AvatarActor, TargetingParams);
+
+		if (ActivationInfo.ActivationMode == EGameplayAbilityActivationMode::Predicting)
+		{
+			if (!InteractionTarget.IsValid())
+			{
+				EndAbility(Handle, ActorInfo, ActivationInfo, true, false);
+				return;
+			}
+			SendTargetToServer();
+			FPredictionKey activationKey = ActivationInfo.GetActivationPredictionKey();
+			activationKey.NewRejectedDelegate().BindUObject(this, &UGAInteraction::OnActivationRejected);
 		}
+
+		if (InteractionTarget.IsValid())
+			StartInteraction(Handle, ActorInfo, ActivationInfo, TriggerEventData);
 		else EndAbility(Handle, ActorInfo, ActivationInfo, false, false);
 	}
 	else
@@ -53,218 +210,2745 @@ void UGAInteraction::ActivateAbility(const FGameplayAbilitySpecHandle Handle, co
 		EndAbility(Handle, ActorInfo, ActivationInfo, false, false);
 	}
 }
-//------------------------------------------------------------------------------------------------------------/GetInteractionTarget/------------------------------------------------------------------------------------------------------------
-AActor* UGAInteraction::GetInteractionTarget(const AActor* AvatarActor)
+
+void UGAInteraction::StartInteraction(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, const FGameplayEventData* TriggerEventData)
 {
-	const float InteractionRadius = 50.f; // Radius of the interaction sphere
-	const float InteractionDistance = 500.f;// Distance from the camera to check for interactable objects
+	// Predicting client waits for the server to end its ability, so the end must be replicated to it
+	const bool replicateEnd = GetNetExecutionPolicy() == EGameplayAbilityNetExecutionPolicy::LocalPredicted;
 
-	if (AvatarActor)
-		if (UCameraComponent* camera = AvatarActor->FindComponentByClass<UCameraComponent>())
+	const FInteractableDescriptor* descriptor = UInteractableRegistrySubsystem::FindDescriptor(InteractionTarget);
+	if (!descriptor)
+	{
+		UE_LOG(LogInteractionSystem, Warning, TEXT("GAInteraction: Target isn't registered in InteractableRegistrySubsystem"));
+		EndAbility(Handle, ActorInfo, ActivationInfo, replicateEnd, true);
+		return;
+	}
+
+	// Dormant interactable must replicate the changes made by the interaction, it stays awake until the ability ends
+	if (HasAuthority(&ActivationInfo) && !NetInteractionActor.IsValid())
+		if (UInteractableRegistrySubsystem* registry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>())
 		{
-			// Trace settings
-			FVector cameraLocation = camera->GetComponentLocation();
-			FVector cameraForward = camera->GetForwardVector();
-			FVector traceEnd = cameraLocation + (cameraForward * InteractionDistance);
-			FCollisionQueryParams queryParams;
-			queryParams.AddIgnoredActor(AvatarActor);
-			FHitResult hitResult;
+			NetInteractionActor = InteractionTarget.Actor;
+			registry->BeginNetInteraction(InteractionTarget.GetActor());
+		}
 
-			if (AvatarActor->GetWorld()->LineTraceSingleByChannel(hitResult, cameraLocation, traceEnd, ECC_Visibility, queryParams))
-			{
-				TArray<FOverlapResult> overlaps;
+	//=====================================================================================================/Implementation of different interaction types/=====================================================================================================
+	HoldDuration = descriptor->HoldDuration;
+	switch (descriptor->Type)
+	{	//----------------------------------------------------------------------------------------------------------------------------------------------/ Press
+	case EInteractionType::Press:
+		// any interaction logic for other types can be added here
+		ExecuteInteraction(&ActivationInfo);
+		// Predicting client keeps the ability active until the server ends or cancels it
+		if (!IsWaitingForServerEnd(ActivationInfo))
+			EndAbility(Handle, ActorInfo, ActivationInfo, replicateEnd, false);
+		break;
+		//----------------------------------------------------------------------------------------------------------------------------------------------/ Hold
+	case EInteractionType::Hold:
+		HoldImplementanion(Handle, ActorInfo, ActivationInfo, TriggerEventData);
+		break;
+		//----------------------------------------------------------------------------------------------------------------------------------------------/ Uknown
+	default:
+		UE_LOG(LogInteractionSystem, Warning, TEXT("GAInteraction: Uknown interaction type. Update interaction gameplay ability"));
+		EndAbility(Handle, ActorInfo, ActivationInfo, replicateEnd, false);
+		break;
+	}//=========================================================================================================================================================================================================================================================
+}
 
-				FVector sphereCenter = hitResult.bBlockingHit ? hitResult.ImpactPoint : traceEnd;
-				FCollisionShape sphereShape = FCollisionShape::MakeSphere(InteractionRadius);
-				if (AvatarActor->GetWorld()->OverlapMultiByChannel(overlaps, sphereCenter, FQuat::Identity, ECC_Visibility, sphereShape, queryParams))
-				{
-					TArray<AActor*> interactableActors;
-					for (const FOverlapResult& overlap : overlaps)
-					{
-						if (overlap.GetActor() && overlap.GetActor()->Implements<UInteractable>())
-						{
-							interactableActors.Add(overlap.GetActor());
-						}
-					}
-					if (interactableActors.Num() > 0)
-					{
-						// Sort interactable actors by distance to the camera
-						interactableActors.Sort([sphereCenter](const AActor& A, const AActor& B)
-							{
-								return FVector::DistSquared(A.GetActorLocation(), sphereCenter) < FVector::DistSquared(B.GetActorLocation(), sphereCenter);
-							});
-						return interactableActors[0];
-					}
-				}
-				else
-					UE_LOG(LogInteractionSystem, Warning, TEXT("GAInteraction: OverlapMultiByChannel failed"));
+void UGAInteraction::EndAbility(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, bool bReplicateEndAbility, bool bWasCancelled)
+{
+	if (IsActive())
+	{
+		// Hold timers must not outlive the ability, e.g. when it is cancelled from outside
+		StopHolding();
+
+		if (ClientTargetDataDelegateHandle.IsValid())
+		{
+			if (UAbilitySystemComponent* asc = ActorInfo ? ActorInfo->AbilitySystemComponent.Get() : nullptr)
+				asc->AbilityTargetDataSetDelegate(Handle, ActivationInfo.GetActivationPredictionKey()).Remove(ClientTargetDataDelegateHandle);
+			ClientTargetDataDelegateHandle.Reset();
+		}
+
+		if (bHoldsArbiterSlot)
+		{
+			if (UInteractionArbiterSubsystem* arbiter = GetWorld()->GetSubsystem<UInteractionArbiterSubsystem>())
+				arbiter->ReleaseSlot(this, ArbiterSlotTarget);
+			bHoldsArbiterSlot = false;
+			ArbiterSlotTarget = FInteractableHandle();
+		}
+		// Request which is still queued belongs to this activation
+		++ArbitrationRequestId;
+
+		if (AActor* netInteractionActor = NetInteractionActor.Get())
+			if (UInteractableRegistrySubsystem* registry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>())
+				registry->EndNetInteraction(netInteractionActor);
+		NetInteractionActor.Reset();
+
+		// Server cancels the ability when it rejects the predicted interaction
+		if (bWasCancelled)
+			RollbackPredictedInteraction();
+		bInteractionPredicted = false;
+	}
+
+	Super::EndAbility(Handle, ActorInfo, ActivationInfo, bReplicateEndAbility, bWasCancelled);
+}
+//------------------------------------------------------------------------------------------------------------/GetInteractionTarget/------------------------------------------------------------------------------------------------------------
+FInteractableHandle UGAInteraction::GetInteractionTarget(const AActor* AvatarActor, const FInteractionTargetingParams& Params, TOptional<float> RewindTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_GetInteractionTarget);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGAInteraction::GetInteractionTarget);
+
+	FInteractableHandle target;
+	FVector origin;
+	FRankedInteractionCandidates ranked;
+	if (RankInteractionCandidates(AvatarActor, Params, origin, ranked, RewindTime))
+	{
+		for (const FInteractionCandidate& candidate : ranked)
+			if (!Params.bRequireLineOfSight || HasLineOfSight(AvatarActor, origin, candidate))
+			{
+				target = candidate.Handle;
+				break;
 			}
+		InteractionStats::RecordQuery(target.IsValid());
+	}
+	return target;
+}
+
+bool UGAInteraction::GetInteractionView(const AActor* AvatarActor, FVector& OutOrigin, FVector& OutDirection)
+{
+	if (AvatarActor)
+	{
+		if (UCameraComponent* camera = AvatarActor->FindComponentByClass<UCameraComponent>())
+		{
+			OutOrigin = camera->GetComponentLocation();
+			OutDirection = camera->GetForwardVector();
+			return true;
 		}
 		else
 			UE_LOG(LogInteractionSystem, Warning, TEXT("GAInteraction: AvatarActor does not have a CameraComponent"));
-	return nullptr;
+	}
+	return false;
+}
+
+bool UGAInteraction::RankInteractionCandidates(const AActor* AvatarActor, const FInteractionTargetingParams& Params, FVector& OutOrigin, FRankedInteractionCandidates& OutRanked, TOptional<float> RewindTime)
+{
+	OutRanked.Reset();
+	FVector direction;
+	if (!GetInteractionView(AvatarActor, OutOrigin, direction))
+		return false;
+
+	const UInteractableRegistrySubsystem* registry = AvatarActor->GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>();
+	if (!registry)
+	{
+		UE_LOG(LogInteractionSystem, Warning, TEXT("GAInteraction: InteractableRegistrySubsystem isn't available in this world"));
+		return false;
+	}
+
+	// Buffers are reused by every query to avoid allocations, targeting runs only on the game thread
+	check(IsInGameThread());
+	static FInteractionCandidates candidates;
+	static TArray<float> scores;
+
+	candidates.Reset(OutOrigin);
+	registry->GatherCandidates(Params.GetQueryBox(OutOrigin, direction), AvatarActor, candidates, RewindTime);
+	candidates.Pad();
+	ScoreInteractionCandidates(candidates, direction, Params, scores);
+
+	// Winners are collected in a single pass over the scores into a short list ordered by score, the rest is never sorted
+	const int32 maxRanked = Params.bRequireLineOfSight ? FMath::Max(Params.MaxLineOfSightChecks, 1) : 1;
+	TArray<int32, TInlineAllocator<4>> bestIndices;
+	for (int32 i = 0; i < candidates.Num; ++i)
+	{
+		const float score = scores[i];
+		if (score == TNumericLimits<float>::Lowest() || (bestIndices.Num() == maxRanked && score <= scores[bestIndices.Last()]))
+			continue;
+		// Equal scores keep the order of candidates
+		int32 position = bestIndices.Num();
+		while (position > 0 && scores[bestIndices[position - 1]] < score)
+			--position;
+		if (bestIndices.Num() == maxRanked)
+			bestIndices.Pop();
+		bestIndices.Insert(i, position);
+	}
+
+	for (const int32 bestIndex : bestIndices)
+	{
+		FInteractionCandidate& candidate = OutRanked.AddDefaulted_GetRef();
+		candidate.Handle = candidates.Handles[bestIndex];
+		candidate.Location = OutOrigin + FVector(candidates.X[bestIndex], candidates.Y[bestIndex], candidates.Z[bestIndex]);
+	}
+	return true;
+}
+
+void UGAInteraction::ScoreInteractionCandidates(const FInteractionCandidates& Candidates, const FVector& Direction, const FInteractionTargetingParams& Params, TArray<float>& OutScores)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_ScoreCandidates);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGAInteraction::ScoreInteractionCandidates);
+
+	const int32 paddedNum = Candidates.X.Num();
+	check(paddedNum % 4 == 0);
+	OutScores.SetNumUninitialized(paddedNum, false);
+
+	const VectorRegister4Float directionX = VectorSetFloat1(static_cast<float>(Direction.X));
+	const VectorRegister4Float directionY = VectorSetFloat1(static_cast<float>(Direction.Y));
+	const VectorRegister4Float directionZ = VectorSetFloat1(static_cast<float>(Direction.Z));
+	const VectorRegister4Float coneTangent = VectorSetFloat1(FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(Params.MaxAngleDegrees, 0.f, 89.f))));
+	const VectorRegister4Float candidateRadius = VectorSetFloat1(Params.CandidateRadius);
+	const VectorRegister4Float inverseMaxDistance = VectorSetFloat1(1.f / FMath::Max(Params.MaxDistance, UE_KINDA_SMALL_NUMBER));
+	const VectorRegister4Float angleWeight = VectorSetFloat1(Params.AngleWeight);
+	const VectorRegister4Float distanceWeight = VectorSetFloat1(Params.DistanceWeight);
+	const VectorRegister4Float minConeRadius = VectorSetFloat1(UE_KINDA_SMALL_NUMBER);
+	const VectorRegister4Float rejected = VectorSetFloat1(TNumericLimits<float>::Lowest());
+	const VectorRegister4Float zero = VectorZeroFloat();
+	const VectorRegister4Float one = VectorOneFloat();
+
+	for (int32 i = 0; i < paddedNum; i += 4)
+	{
+		const VectorRegister4Float x = VectorLoad(&Candidates.X[i]);
+		const VectorRegister4Float y = VectorLoad(&Candidates.Y[i]);
+		const VectorRegister4Float z = VectorLoad(&Candidates.Z[i]);
+		const VectorRegister4Float radius = VectorLoad(&Candidates.Radius[i]);
+
+		// Distance along the view axis and distance from it
+		const VectorRegister4Float along = VectorMultiplyAdd(x, directionX, VectorMultiplyAdd(y, directionY, VectorMultiply(z, directionZ)));
+		const VectorRegister4Float distanceSquared = VectorMultiplyAdd(x, x, VectorMultiplyAdd(y, y, VectorMultiply(z, z)));
+		const VectorRegister4Float fromAxis = VectorSqrt(VectorMax(VectorSubtract(distanceSquared, VectorMultiply(along, along)), zero));
+
+		// 0 when the bounds touch the view axis, 1 on the border of the widened cone
+		const VectorRegister4Float coneRadius = VectorMax(VectorMultiplyAdd(VectorMax(along, zero), coneTangent, candidateRadius), minConeRadius);
+		const VectorRegister4Float angleTerm = VectorDivide(VectorMax(VectorSubtract(fromAxis, radius), zero), coneRadius);
+		// 0 when the bounds reach the camera, 1 at MaxDistance
+		const VectorRegister4Float distanceTerm = VectorMultiply(VectorMax(VectorSubtract(along, radius), zero), inverseMaxDistance);
+
+		const VectorRegister4Float score = VectorNegate(VectorMultiplyAdd(angleTerm, angleWeight, VectorMultiply(distanceTerm, distanceWeight)));
+		const VectorRegister4Float inFront = VectorCompareGT(VectorAdd(along, radius), zero);
+		const VectorRegister4Float inCone = VectorBitwiseAnd(VectorCompareLE(angleTerm, one), VectorCompareLE(distanceTerm, one));
+		VectorStore(VectorSelect(VectorBitwiseAnd(inFront, inCone), score, rejected), &OutScores[i]);
+	}
+}
+
+bool UGAInteraction::HasLineOfSight(const AActor* AvatarActor, const FVector& Origin, const FInteractionCandidate& Candidate)
+{
+	FCollisionQueryParams queryParams;
+	queryParams.AddIgnoredActor(AvatarActor);
+	FHitResult hitResult;
+
+	InteractionStats::RecordLineOfSightTrace();
+	if (!AvatarActor->GetWorld()->LineTraceSingleByChannel(hitResult, Origin, Candidate.Location, ECC_Visibility, queryParams))
+		return true;
+	return IsHitOnTarget(hitResult, Candidate.Handle);
+}
+
+bool UGAInteraction::IsHitOnTarget(const FHitResult& HitResult, const FInteractableHandle& Target)
+{
+	if (HitResult.GetActor() != Target.GetActor())
+		return false;
+	// Item of a hit on instanced mesh is the index of the instance
+	return !Target.IsInstance() || (HitResult.GetComponent() && HitResult.GetComponent()->IsA<UInteractableInstancedStaticMeshComponent>() && HitResult.Item == Target.InstanceIndex);
+}
+
+const FInteractionTargetingParams& UGAInteraction::GetTargetingParams(const AActor* AvatarActor)
+{
+	static const FInteractionTargetingParams defaultParams;
+
+	if (const UAbilitySystemComponent* asc = UAbilitySystemGlobals::GetAbilitySystemComponentFromActor(AvatarActor))
+		for (const FGameplayAbilitySpec& spec : asc->GetActivatableAbilities())
+			if (const UGAInteraction* ability = Cast<UGAInteraction>(spec.Ability))
+				return ability->TargetingParams;
+	return defaultParams;
+}
+
+FInteractableHandle UGAInteraction::GetCachedInteractionTarget(const AActor* AvatarActor, const FInteractionTargetingParams& Params, uint32 MaxFrameAge)
+{
+	if (AvatarActor)
+		if (UInteractionTargetingSubsystem* targeting = AvatarActor->GetWorld()->GetSubsystem<UInteractionTargetingSubsystem>())
+			return targeting->GetInteractionTarget(AvatarActor, Params, MaxFrameAge);
+	return GetInteractionTarget(AvatarActor, Params);
 }
 void UGAInteraction::ExecuteInteraction(const FGameplayAbilityActivationInfo* ActivationInfo)
 {
+	AActor* targetActor = InteractionTarget.GetActor();
 	if (HasAuthority(ActivationInfo))
 	{
-		IInteractable::Execute_Interact(TargetActor, AvatarActor);
+		if (InteractionTarget.IsInstance())
+			IInteractable::Execute_InteractWithInstance(targetActor, AvatarActor, InteractionTarget.InstanceIndex);
+		else IInteractable::Execute_Interact(targetActor, AvatarActor);
+	}
+	// Prediction hooks of IInteractable are per actor, instances are changed only by server
+	else if (ActivationInfo->ActivationMode == EGameplayAbilityActivationMode::Predicting && !InteractionTarget.IsInstance())
+	{
+		IInteractable::Execute_PredictInteract(targetActor, AvatarActor);
+		bInteractionPredicted = true;
 	}
 }
-//------------------------------------------------------------------------------------------------------------/OnReleaseHold/------------------------------------------------------------------------------------------------------------
-void UGAInteraction::InterruptHolding(float TimeHeld)
+//------------------------------------------------------------------------------------------------------------/Prediction/------------------------------------------------------------------------------------------------------------
+void UGAInteraction::SendTargetToServer()
 {
-	AvatarActor->GetWorld()->GetTimerManager().ClearTimer(HoldTimerHandle);
-	if (InteractionSubsystem)
-		if (UInteractionWidget* widget = InteractionSubsystem->GetWidget())
-			widget->UpdateProgressBar(0.f);
-	HoldingTime = 0.f;
-	EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, true);
+	UAbilitySystemComponent* asc = GetAbilitySystemComponentFromActorInfo();
+	FScopedPredictionWindow scopedPrediction(asc);
+
+	FGameplayAbilityTargetData_Interaction* targetData = new FGameplayAbilityTargetData_Interaction();
+	targetData->Target = InteractionTarget.Actor;
+	targetData->InstanceIndex = InteractionTarget.InstanceIndex;
+	targetData->ClientTimestamp = GetServerWorldTime(GetWorld());
+	FGameplayAbilityTargetDataHandle targetDataHandle(targetData);
+
+	asc->ServerSetReplicatedTargetData(CurrentSpecHandle, CurrentActivationInfo.GetActivationPredictionKey(), targetDataHandle, FGameplayTag(), asc->ScopedPredictionKey);
+	InteractionStats::RecordRPC();
 }
-//------------------------------------------------------------------------------------------------------------//------------------------------------------------------------------------------------------------------------
-void UGAInteraction::HoldImplementanion(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, const FGameplayEventData* TriggerEventData)
-{
-	const float tickRate = 0.02f; // Timer tick rate
 
-	HoldDuration = IInteractable::Execute_GetHoldDuration(TargetActor);
+void UGAInteraction::OnClientTargetDataReceived(const FGameplayAbilityTargetDataHandle& TargetDataHandle, FGameplayTag ApplicationTag)
+{
+	GetAbilitySystemComponentFromActorInfo()->ConsumeClientReplicatedTargetData(CurrentSpecHandle, CurrentActivationInfo.GetActivationPredictionKey());
+	InteractionStats::RecordRPC();
 
-	GetWorld()->GetTimerManager().SetTimer(HoldTimerHandle, [this, tickRate]()
+	FInteractableHandle clientTarget;
+	float clientTimestamp = GetServerWorldTime(GetWorld());
+	if (const FGameplayAbilityTargetData* targetData = TargetDataHandle.Get(0))
+		if (targetData->GetScriptStruct() == FGameplayAbilityTargetData_Interaction::StaticStruct())
 		{
-			if (HoldDuration <= HoldingTime && IsValid(TargetActor) && IsValid(AvatarActor))
-			{
-				//Holding sucessfully finished
-				AvatarActor->GetWorld()->GetTimerManager().ClearTimer(HoldTimerHandle);
-				FGameplayAbilityActivationInfo activationInfo = GetCurrentActivationInfo();
-				ExecuteInteraction(&activationInfo);
-				HoldingTime = 0.f;
-				if(InteractionSubsystem)
-					if (UInteractionWidget* widget = InteractionSubsystem->GetWidget())
-						widget->UpdateProgressBar(0.f);
-				EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, false);
-			}
-			else
-			{   //Interrupt execution if the target has changed
-				if (GetInteractionTarget(AvatarActor) != TargetActor)
-				{
-					AvatarActor->GetWorld()->GetTimerManager().ClearTimer(HoldTimerHandle);
-					HoldingTime = 0.f;
-					if (InteractionSubsystem)
-						if (UInteractionWidget* widget = InteractionSubsystem->GetWidget())
-							widget->UpdateProgressBar(0.f);
-					EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, true);
-				}
-				else
-				{
-					HoldingTime += tickRate;
-					if (InteractionSubsystem)
-						if (UInteractionWidget* widget = InteractionSubsystem->GetWidget())
-							widget->UpdateProgressBar(HoldingTime / HoldDuration);
-				}
-			}
+			const FGameplayAbilityTargetData_Interaction* interactionData = static_cast<const FGameplayAbilityTargetData_Interaction*>(targetData);
+			clientTarget = FInteractableHandle(interactionData->Target.Get(), interactionData->InstanceIndex);
+			clientTimestamp = interactionData->ClientTimestamp;
+		}
 
-		}, tickRate, true);
+	if (IsValidClientTarget(clientTarget, clientTimestamp))
+	{
+		InteractionTarget = clientTarget;
+		// Client has started earlier than the request arrived, but no more than MaxHoldClockSkew is credited
+		HoldTimeCredit = FMath::Clamp(GetServerWorldTime(GetWorld()) - clientTimestamp, 0.f, MaxHoldClockSkew);
+		if (!SubmitToArbiter(clientTarget))
+			StartInteraction(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, nullptr);
+	}
+	else
+	{
+		UE_LOG(LogInteractionSystem, Verbose, TEXT("GAInteraction: Predicted interaction target is rejected by server"));
+		EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, true);
+	}
+}
 
-	UAbilityTask_WaitInputRelease* WaitInputReleaseTask = UAbilityTask_WaitInputRelease::WaitInputRelease(this, true);
-	WaitInputReleaseTask->OnRelease.AddDynamic(this, &UGAInteraction::InterruptHolding);
-	WaitInputReleaseTask->ReadyForActivation();
+bool UGAInteraction::IsValidClientTarget(const FInteractableHandle& ClientTarget, float ClientTimestamp) const
+{
+	if (!ClientTarget.IsValid() || !UInteractableRegistrySubsystem::FindDescriptor(ClientTarget))
+		return false;
+	// Client has aimed at interactables as they were RTT/2 ago. Server could also see a slightly different picture, so the target is accepted when it is within reach.
+	return GetInteractionTarget(AvatarActor, TargetingParams, ClientTimestamp) == ClientTarget || IsTargetInReach(AvatarActor, ClientTarget, TargetingParams, ClientTargetTolerance, ClientTimestamp);
 }
-//------------------------------------------------------------------------------------------------------------//------------------------------------------------------------------------------------------------------------
-void AGC_InteractableOutlinig::Tick(float DeltaTime)
+
+bool UGAInteraction::IsTargetInReach(const AActor* AvatarActor, const FInteractableHandle& Target, const FInteractionTargetingParams& Params, float Tolerance, TOptional<float> RewindTime)
 {
-	Super::Tick(DeltaTime);
+	FVector origin, direction;
+	const AActor* targetActor = Target.GetActor();
+	if (!targetActor || !GetInteractionView(AvatarActor, origin, direction))
+		return false;
 
-	if (CueInstigator == nullptr) UE_LOG(LogTemp, Warning, TEXT("GC_InteractableOutlinig: CueInstigator is null. Check if the Gameplay Cue called with setting it"));
-	//AActor* avatarActor = Cast<AMyPlayerState>(CueInstigator.Get())->GetAbilitySystemComponent()->GetAvatarActor();
-	AActor* NewTarget = UGAInteraction::GetInteractionTarget(CueInstigator.Get());
-	if (CurrentTarget != NewTarget)
+	FBox bounds(ForceInit);
+	const UInteractableRegistrySubsystem* registry = targetActor->GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>();
+	if (!RewindTime.IsSet() || !registry || !registry->GetBoundsAtTime(Target, RewindTime.GetValue(), bounds))
 	{
-		// Remove highlight from the last target
-		if (CurrentTarget != nullptr)
+		if (Target.IsInstance())
 		{
-			for (auto mesh : IInteractable::Execute_GetMeshesForOutlining(CurrentTarget))
-			{
-				mesh->SetRenderCustomDepth(false);
-			}
+			const UInteractableInstancedStaticMeshComponent* instancedMesh = targetActor->FindComponentByClass<UInteractableInstancedStaticMeshComponent>();
+			if (!instancedMesh || !instancedMesh->IsInstanceEnabled(Target.InstanceIndex))
+				return false;
+			bounds = instancedMesh->GetInstanceBounds(Target.InstanceIndex);
 		}
-		// Add highlight to the current target
-		if (NewTarget != nullptr)
+		else
 		{
-			for (auto mesh : IInteractable::Execute_GetMeshesForOutlining(NewTarget))
-			{
-				mesh->SetRenderCustomDepth(true);
-				mesh->SetCustomDepthStencilValue(1);
-			}
+			bounds = targetActor->GetComponentsBoundingBox();
+			if (!bounds.IsValid)
+				bounds = FBox(targetActor->GetActorLocation(), targetActor->GetActorLocation());
 		}
-		// Broadcast the target change event
-		OnTargetChanged(CurrentTarget, NewTarget);
+	}
 
-		CurrentTarget = NewTarget;
+	// Same scoring as the query, so both agree on what is within reach. Buffers are reused, validation runs only on the game thread.
+	check(IsInGameThread());
+	static FInteractionCandidates candidates;
+	static TArray<float> scores;
+	candidates.Reset(origin);
+	candidates.Add(Target, bounds);
+	candidates.Pad();
+
+	FInteractionTargetingParams tolerantParams = Params;
+	tolerantParams.CandidateRadius += Tolerance;
+	tolerantParams.MaxDistance += Tolerance;
+	ScoreInteractionCandidates(candidates, direction, tolerantParams, scores);
+	return scores[0] > TNumericLimits<float>::Lowest();
+}
+
+bool UGAInteraction::SubmitToArbiter(const FInteractableHandle& PresetTarget)
+{
+	UInteractionArbiterSubsystem* arbiter = GetWorld()->GetSubsystem<UInteractionArbiterSubsystem>();
+	if (!arbiter)
+		return false;
+
+	arbiter->SubmitRequest(this, AvatarActor, GetOwningActorFromActorInfo(), PresetTarget, TargetingParams, FOnInteractionArbitrated::CreateUObject(this, &UGAInteraction::OnArbitrated, ++ArbitrationRequestId));
+	return true;
+}
+
+void UGAInteraction::OnArbitrated(EInteractionArbitrationResult Result, const FInteractableHandle& GrantedTarget, uint32 RequestId)
+{
+	if (RequestId != ArbitrationRequestId || !IsActive())
+	{
+		// Ability has ended while the request was queued
+		if (Result == EInteractionArbitrationResult::Granted)
+			if (UInteractionArbiterSubsystem* arbiter = GetWorld()->GetSubsystem<UInteractionArbiterSubsystem>())
+				arbiter->ReleaseSlot(this, GrantedTarget);
+		return;
+	}
+
+	if (Result != EInteractionArbitrationResult::Granted)
+	{
+		UE_LOG(LogInteractionSystem, Verbose, TEXT("GAInteraction: Interaction is rejected by InteractionArbiterSubsystem: %s"), *UEnum::GetValueAsString(Result));
+		// Predicting client rolls back, ServerInitiated client instance ends as well
+		EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, Result != EInteractionArbitrationResult::NoTarget || GetNetExecutionPolicy() == EGameplayAbilityNetExecutionPolicy::LocalPredicted);
+		return;
 	}
+
+	bHoldsArbiterSlot = true;
+	ArbiterSlotTarget = GrantedTarget;
+	InteractionTarget = GrantedTarget;
+	StartInteraction(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, nullptr);
 }
-void AGC_InteractableOutlinig::StartGameplayCue(const UAbilitySystemComponent* ASC, const FGameplayCueParameters& parameters)
+
+void UGAInteraction::OnActivationRejected()
 {
-	FGameplayTag gameplayCueTag = FGameplayTag::RequestGameplayTag(FName("GameplayCue.InteractableOutlining"));
-	UAbilitySystemGlobals::Get().GetGameplayCueManager()->HandleGameplayCue(ASC->GetOwner(), gameplayCueTag, EGameplayCueEvent::Type::OnActive, parameters);
-	UAbilitySystemGlobals::Get().GetGameplayCueManager()->HandleGameplayCue(ASC->GetOwner(), gameplayCueTag, EGameplayCueEvent::Type::WhileActive, parameters);
+	// Server has failed to activate the ability at all
+	RollbackPredictedInteraction();
+	bInteractionPredicted = false;
 }
 
-void AGC_InteractableOutlinig::HandleGameplayCue(AActor* MyTarget, EGameplayCueEvent::Type EventType, const FGameplayCueParameters& Parameters)
+bool UGAInteraction::IsWaitingForServerEnd(const FGameplayAbilityActivationInfo& ActivationInfo) const
 {
-	Super::HandleGameplayCue(MyTarget, EventType, Parameters);
+	// Also with nothing predicted, e.g. for instances: a replicated end could reach the server before its arbiter has granted the request
+	return GetNetExecutionPolicy() == EGameplayAbilityNetExecutionPolicy::LocalPredicted && !HasAuthority(&ActivationInfo);
+}
 
-	if (IAbilitySystemInterface* playerController = Cast<IAbilitySystemInterface>(Parameters.GetInstigator()))
-		InteractionSubsystem = Cast<APlayerController>(playerController->GetAbilitySystemComponent()->GetOwnerActor()->GetOwner())->GetLocalPlayer()->GetSubsystem<UInteractionLocalPlayerSubsystem>();
-	else UE_LOG(LogInteractionSystem, Warning, TEXT("AGC_InteractableOutlinig: Instigator don`t implement IAbilitySystemInterface"));
+void UGAInteraction::RollbackPredictedInteraction()
+{
+	if (bInteractionPredicted && InteractionTarget.IsValid())
+		IInteractable::Execute_RollbackPredictedInteract(InteractionTarget.GetActor(), AvatarActor);
 }
 
-void AGC_InteractableOutlinig::OnTargetChanged_Implementation(AActor* OldTarget, AActor* NewTarget)
+float UGAInteraction::GetServerWorldTime(const UWorld* World)
 {
-	if (InteractionSubsystem)
-		InteractionSubsystem->GetWidget()->TargetChanged(CurrentTarget, NewTarget);
+	if (const AGameStateBase* gameState = World->GetGameState())
+		return static_cast<float>(gameState->GetServerWorldTimeSeconds());
+	return World->GetTimeSeconds();
+}
+//------------------------------------------------------------------------------------------------------------/OnReleaseHold/------------------------------------------------------------------------------------------------------------
+void UGAInteraction::InterruptHolding(float TimeHeld)
+{
+	EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, true);
+}
+void UGAInteraction::OnHoldTargetResolved(const FInteractableHandle& NewTarget)
+{
+	if (IsActive() && (GetWorld()->GetTimerManager().IsTimerActive(HoldTimerHandle) || bSharedHold) && NewTarget != InteractionTarget)
+		InterruptHolding(GetWorld()->GetTimeSeconds() - HoldStartTime);
 }
 //------------------------------------------------------------------------------------------------------------//------------------------------------------------------------------------------------------------------------
-UInteractionWidget* UInteractionLocalPlayerSubsystem::GetWidget()
+void UGAInteraction::HoldImplementanion(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, const FGameplayEventData* TriggerEventData)
 {
-	if (!InteractionWidget)
+	// HoldTimeCredit is non-zero only on server for holds started by a predicting client
+	HoldStartTime = GetWorld()->GetTimeSeconds() - HoldTimeCredit;
+
+	// Own hold on a shared target runs at HoldContribution speed, other holders can only make it faster
+	UInteractionHoldComponent* holdComponent = InteractionTarget.GetActor()->FindComponentByClass<UInteractionHoldComponent>();
+	const bool bJoinSharedHold = holdComponent && HasAuthority(&CurrentActivationInfo);
+	const float ownHoldDuration = holdComponent ? HoldDuration / FMath::Max(HoldContribution, UE_KINDA_SMALL_NUMBER) : HoldDuration;
+
+	// Shared hold credited with a completed hold is completed by the component. Hold without duration completes immediately, the component doesn't accept it.
+	const float remainingTime = ownHoldDuration - HoldTimeCredit;
+	if (HoldDuration <= 0.f || (remainingTime <= 0.f && !bJoinSharedHold))
 	{
-		if (UClass* LoadedObject = Cast<UClass>(InteractionWidgetClassPath.TryLoad()))
-			InteractionWidget = CreateWidget<UInteractionWidget>(GetWorld(), LoadedObject);
-		else
+		FinishHolding();
+		return;
+	}
+
+	FTimerManager& timerManager = GetWorld()->GetTimerManager();
+	InteractionStats::ChangeActiveHolds(1);
+	if (bJoinSharedHold)
+	{
+		// Holds of all instigators are combined by the component, it decides when and by whom the interaction is executed
+		bSharedHold = true;
+		SharedHoldComponent = holdComponent;
+		SharedHoldCompletedHandle = holdComponent->OnHoldCompleted.AddUObject(this, &UGAInteraction::OnSharedHoldCompleted);
+		holdComponent->AddHolder(AvatarActor, InteractionTarget.InstanceIndex, HoldDuration, HoldContribution, HoldTimeCredit);
+		if (!IsActive())
+			return; // Completed by the contribution of this holder
+	}
+	else
+		// Completion is a single one-shot timer, progress is derived from the start timestamp
+		timerManager.SetTimer(HoldTimerHandle, this, &UGAInteraction::FinishHolding, remainingTime, false);
+	if (HoldRevalidationInterval > 0.f)
+		timerManager.SetTimer(HoldValidationTimerHandle, this, &UGAInteraction::ValidateHoldTarget, HoldRevalidationInterval, true);
+
+	if (InteractionSubsystem)
+		if (UInteractionWidget* widget = InteractionSubsystem->GetWidget())
 		{
-			UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: InteractionWidgetClass is not set. Please set it in the config DefaultGame.ini file."));
-			return nullptr;
+			widget->StartHoldProgress(HoldStartTime, ownHoldDuration);
+			if (holdComponent)
+				widget->SetSharedHoldProgress(holdComponent, InteractionTarget.InstanceIndex);
 		}
+
+	WaitInputReleaseTask = UAbilityTask_WaitInputRelease::WaitInputRelease(this, true);
+	WaitInputReleaseTask->OnRelease.AddDynamic(this, &UGAInteraction::InterruptHolding);
+	WaitInputReleaseTask->ReadyForActivation();
+}
+
+void UGAInteraction::ValidateHoldTarget()
+{
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_ValidateHoldTarget);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGAInteraction::ValidateHoldTarget);
+
+	const uint32 targetMaxFrameAge = 2; // Re-validation of the target may use a result shared with the outlining cue
+
+	//Interrupt execution if the target has changed
+	UInteractionTargetingSubsystem* targeting = GetWorld()->GetSubsystem<UInteractionTargetingSubsystem>();
+	if (!InteractionTarget.IsValid() || !IsValid(AvatarActor))
+		InterruptHolding(GetWorld()->GetTimeSeconds() - HoldStartTime);
+	else if (bUseAsyncTargeting && targeting)
+		// Result arrives in one of the next frames, holding continues until then
+		targeting->RequestInteractionTargetAsync(AvatarActor, TargetingParams, FOnInteractionTargetResolved::CreateUObject(this, &UGAInteraction::OnHoldTargetResolved));
+	else if (GetCachedInteractionTarget(AvatarActor, TargetingParams, targetMaxFrameAge) != InteractionTarget)
+		InterruptHolding(GetWorld()->GetTimeSeconds() - HoldStartTime);
+}
+
+void UGAInteraction::FinishHolding()
+{
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_FinishHolding);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGAInteraction::FinishHolding);
+
+	if (InteractionTarget.IsValid() && IsValid(AvatarActor))
+	{
+		//Holding sucessfully finished
+		FGameplayAbilityActivationInfo activationInfo = GetCurrentActivationInfo();
+		ExecuteInteraction(&activationInfo);
+		// Predicting client keeps the ability active until the server ends or cancels it, releasing input no longer matters
+		if (IsWaitingForServerEnd(GetCurrentActivationInfo()))
+			StopHolding();
+		else EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, false);
 	}
-	return InteractionWidget;
+	else EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, true);
 }
-//------------------------------------------------------------------------------------------------------------//------------------------------------------------------------------------------------------------------------
-void UInteractionLocalPlayerSubsystem::PlayerControllerChanged(APlayerController* NewPlayerController)
+
+void UGAInteraction::OnSharedHoldCompleted(int32 InstanceIndex, AActor* Executor)
 {
-	Super::PlayerControllerChanged(NewPlayerController);
+	if (!IsActive() || !bSharedHold || InstanceIndex != InteractionTarget.InstanceIndex)
+		return;
 
-	if (NewPlayerController)
-		NewPlayerController->OnPossessedPawnChanged.AddDynamic(this, &UInteractionLocalPlayerSubsystem::OnPawnChanged_Callback);
+	// Holders are already removed by the component
+	bSharedHold = false;
+	if (UInteractionHoldComponent* holdComponent = SharedHoldComponent.Get())
+		holdComponent->OnHoldCompleted.Remove(SharedHoldCompletedHandle);
+	SharedHoldComponent.Reset();
+	SharedHoldCompletedHandle.Reset();
+	InteractionStats::ChangeActiveHolds(-1);
+
+	// Only one holder executes the interaction. Predicting client of another holder may have finished its local hold first, so it is cancelled to roll the prediction back.
+	if (Executor == AvatarActor)
+		FinishHolding();
+	else EndAbility(CurrentSpecHandle, CurrentActorInfo, CurrentActivationInfo, true, GetNetExecutionPolicy() == EGameplayAbilityNetExecutionPolicy::LocalPredicted);
 }
 
-void UInteractionLocalPlayerSubsystem::OnPawnChanged_Callback(APawn* OldPawn, APawn* NewPawn)
+void UGAInteraction::StopHolding()
 {
-	if (NewPawn)
+	FTimerManager& timerManager = GetWorld()->GetTimerManager();
+	if (HoldTimerHandle.IsValid() || bSharedHold)
+		InteractionStats::ChangeActiveHolds(-1);
+	timerManager.ClearTimer(HoldTimerHandle);
+	if (bSharedHold)
 	{
-		if (UCameraComponent* CameraComponent = NewPawn->FindComponentByClass<UCameraComponent>())
+		bSharedHold = false;
+		if (UInteractionHoldComponent* holdComponent = SharedHoldComponent.Get())
 		{
-			if (UMaterialInterface* PPMaterial = Cast<UMaterialInterface>(PostprocessOutliningMaterialPath.TryLoad()))
-			{
-				CameraComponent->PostProcessSettings.AddBlendable(PPMaterial, 1.0f);
-				CameraComponent->PostProcessBlendWeight = 1.0f;
-			}
-			else
-			{
-				UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: PostprocessOutliningMaterial is not set. Please set it in the config DefaultGame.ini file."));
+			holdComponent->OnHoldCompleted.Remove(SharedHoldCompletedHandle);
+			holdComponent->RemoveHolder(AvatarActor, InteractionTarget.InstanceIndex);
+		}
+		SharedHoldComponent.Reset();
+		SharedHoldCompletedHandle.Reset();
+	}
+	timerManager.ClearTimer(HoldValidationTimerHandle);
+	if (WaitInputReleaseTask)
+	{
+		WaitInputReleaseTask->EndTask();
+		WaitInputReleaseTask = nullptr;
+	}
+	if (InteractionSubsystem)
+		if (UInteractionWidget* widget = InteractionSubsystem->GetWidget())
+			widget->StopHoldProgress();
+}
+//------------------------------------------------------------------------------------------------------------//------------------------------------------------------------------------------------------------------------
+void AGC_InteractableOutlinig::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_OutliningTick);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AGC_InteractableOutlinig::Tick);
+
+	Super::Tick(DeltaTime);
+
+	if (CueInstigator == nullptr) UE_LOG(LogTemp, Warning, TEXT("GC_InteractableOutlinig: CueInstigator is null. Check if the Gameplay Cue called with setting it"));
+	// Target destroyed while outlined is dropped even if the query is skipped
+	if (CurrentTarget.Actor.IsStale())
+		SetCurrentTarget(FInteractableHandle());
+	//AActor* avatarActor = Cast<AMyPlayerState>(CueInstigator.Get())->GetAbilitySystemComponent()->GetAvatarActor();
+	// Outlining must show the same target as the ability would choose. The ability can be granted after the cue has started.
+	if (!bTargetingParamsResolved)
+	{
+		const UAbilitySystemComponent* asc = UAbilitySystemGlobals::GetAbilitySystemComponentFromActor(CueInstigator.Get());
+		TargetingParams = UGAInteraction::GetTargetingParams(CueInstigator.Get());
+		bTargetingParamsResolved = asc && asc->GetActivatableAbilities().ContainsByPredicate([](const FGameplayAbilitySpec& Spec) { return Spec.Ability && Spec.Ability->IsA<UGAInteraction>(); });
+	}
+
+	if (!ShouldQueryTarget(DeltaTime))
+		return;
+
+	UInteractionTargetingSubsystem* targeting = GetWorld()->GetSubsystem<UInteractionTargetingSubsystem>();
+	if (bUseAsyncTargeting && targeting)
+		targeting->RequestInteractionTargetAsync(CueInstigator.Get(), TargetingParams, FOnInteractionTargetResolved::CreateUObject(this, &AGC_InteractableOutlinig::SetCurrentTarget));
+	else
+		SetCurrentTarget(UGAInteraction::GetCachedInteractionTarget(CueInstigator.Get(), TargetingParams));
+}
+bool AGC_InteractableOutlinig::ShouldQueryTarget(float DeltaTime)
+{
+	FVector traceStart, traceDirection;
+	if (!UGAInteraction::GetInteractionView(CueInstigator.Get(), traceStart, traceDirection))
+		return true;
+
+	const float now = GetWorld()->GetTimeSeconds();
+
+	// Faster view movement gives shorter tick interval
+	if (DeltaTime > 0.f && bHasLastTickPose)
+	{
+		const float angularSpeed = FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(FVector::DotProduct(traceDirection, LastTickTraceDirection), -1.f, 1.f))) / DeltaTime;
+		const float linearSpeed = FVector::Dist(traceStart, LastTickTraceStart) / DeltaTime;
+		const float viewSpeedAlpha = FMath::Clamp(FMath::Max(angularSpeed / FastViewAngularSpeed, linearSpeed / FastViewLinearSpeed), 0.f, 1.f);
+		SetActorTickInterval(FMath::Lerp(MaxTickInterval, MinTickInterval, viewSpeedAlpha));
+	}
+	LastTickTraceStart = traceStart;
+	LastTickTraceDirection = traceDirection;
+	bHasLastTickPose = true;
+
+	// Interactables which can be found by the query are only inside the view cone
+	uint64 revision = 0;
+	if (const UInteractableRegistrySubsystem* registry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>())
+		revision = registry->GetRevisionInBox(TargetingParams.GetQueryBox(traceStart, traceDirection));
+
+	const bool bCameraMoved = !bHasLastQueryPose
+		|| FVector::DistSquared(traceStart, LastQueryTraceStart) > FMath::Square(MinCameraMoveDistance)
+		|| FVector::DotProduct(traceDirection, LastQueryTraceDirection) < FMath::Cos(FMath::DegreesToRadians(MinCameraRotationDegrees));
+	if (!bCameraMoved && revision == LastQueryRevision && now - LastQueryTime < MaxSkippedQueryTime)
+		return false;
+
+	LastQueryTraceStart = traceStart;
+	LastQueryTraceDirection = traceDirection;
+	LastQueryRevision = revision;
+	LastQueryTime = now;
+	bHasLastQueryPose = true;
+	return true;
+}
+void AGC_InteractableOutlinig::SetCurrentTarget(const FInteractableHandle& NewTarget)
+{
+	if (CurrentTarget != NewTarget)
+	{
+		// Outline manager applies only the difference at the end of the frame
+		if (UInteractionOutlineSubsystem* outlines = GetWorld()->GetSubsystem<UInteractionOutlineSubsystem>())
+		{
+			outlines->SetOutlined(CurrentTarget, EInteractionOutlineLayer::Focused, false);
+			outlines->SetOutlined(NewTarget, EInteractionOutlineLayer::Focused, true);
+		}
+		const FInteractableHandle oldTarget = CurrentTarget;
+		CurrentTarget = NewTarget;
+
+		// Broadcast the target change event. Change of the instance of the same actor is a change as well.
+		OnTargetChanged(oldTarget.GetActor(), NewTarget.GetActor());
+	}
+}
+void AGC_InteractableOutlinig::StartGameplayCue(const UAbilitySystemComponent* ASC, const FGameplayCueParameters& parameters)
+{
+	FGameplayTag gameplayCueTag = FGameplayTag::RequestGameplayTag(FName("GameplayCue.InteractableOutlining"));
+	UAbilitySystemGlobals::Get().GetGameplayCueManager()->HandleGameplayCue(ASC->GetOwner(), gameplayCueTag, EGameplayCueEvent::Type::OnActive, parameters);
+	UAbilitySystemGlobals::Get().GetGameplayCueManager()->HandleGameplayCue(ASC->GetOwner(), gameplayCueTag, EGameplayCueEvent::Type::WhileActive, parameters);
+}
+
+void AGC_InteractableOutlinig::HandleGameplayCue(AActor* MyTarget, EGameplayCueEvent::Type EventType, const FGameplayCueParameters& Parameters)
+{
+	Super::HandleGameplayCue(MyTarget, EventType, Parameters);
+
+	if (IAbilitySystemInterface* playerController = Cast<IAbilitySystemInterface>(Parameters.GetInstigator()))
+		InteractionSubsystem = Cast<APlayerController>(playerController->GetAbilitySystemComponent()->GetOwnerActor()->GetOwner())->GetLocalPlayer()->GetSubsystem<UInteractionLocalPlayerSubsystem>();
+	else UE_LOG(LogInteractionSystem, Warning, TEXT("AGC_InteractableOutlinig: Instigator don`t implement IAbilitySystemInterface"));
+}
+
+void AGC_InteractableOutlinig::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Outline request of the cue must not outlive it
+	SetCurrentTarget(FInteractableHandle());
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AGC_InteractableOutlinig::OnTargetChanged_Implementation(AActor* OldTarget, AActor* NewTarget)
+{
+	if (InteractionSubsystem)
+		if (UInteractionWidget* widget = InteractionSubsystem->GetWidget())
+		{
+			widget->TargetHandle = CurrentTarget;
+			widget->TargetChanged(OldTarget, NewTarget);
+		}
+}
+//------------------------------------------------------------------------------------------------------------/UInteractionOutlineSubsystem/------------------------------------------------------------------------------------------------------------
+void UInteractionOutlineSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UInteractionOutlineSubsystem::OnWorldPostActorTick);
+}
+
+void UInteractionOutlineSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	Requests.Empty();
+	AppliedMeshes.Empty();
+	AppliedInstances.Empty();
+
+	Super::Deinitialize();
+}
+
+void UInteractionOutlineSubsystem::SetOutlined(const FInteractableHandle& Target, EInteractionOutlineLayer Layer, bool bOutlined)
+{
+	if (Layer == EInteractionOutlineLayer::None)
+		return;
+
+	const int32 layerIndex = static_cast<int32>(Layer) - 1;
+	if (bOutlined)
+	{
+		if (!Target.IsValid())
+			return;
+		if (Requests.FindOrAdd(Target).Counts[layerIndex]++ == 0)
+			bDirty = true;
+	}
+	// Stale handle is still found, its weak pointer keeps the hash
+	else if (FOutlineRequests* layerRequests = Requests.Find(Target))
+	{
+		if (layerRequests->Counts[layerIndex] == 0 || --layerRequests->Counts[layerIndex] > 0)
+			return;
+		if (GetTopLayer(*layerRequests) == EInteractionOutlineLayer::None)
+			Requests.Remove(Target);
+		bDirty = true;
+	}
+}
+
+bool UInteractionOutlineSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UInteractionOutlineSubsystem::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld())
+		return;
+
+	// Destroyed targets are dropped, their meshes are gone with them
+	for (auto it = Requests.CreateIterator(); it; ++it)
+		if (!it.Key().IsValid())
+		{
+			it.RemoveCurrent();
+			bDirty = true;
+		}
+
+	if (bDirty)
+		ApplyOutlines();
+}
+
+void UInteractionOutlineSubsystem::ApplyOutlines()
+{
+	bDirty = false;
+
+	// Desired state of every mesh, a mesh shared by several targets gets the layer with the highest priority
+	TMap<TWeakObjectPtr<UMeshComponent>, EInteractionOutlineLayer> meshes;
+	TMap<TPair<TWeakObjectPtr<UInteractableInstancedStaticMeshComponent>, int32>, EInteractionOutlineLayer> instances;
+	for (const TPair<FInteractableHandle, FOutlineRequests>& request : Requests)
+	{
+		const FInteractableDescriptor* descriptor = UInteractableRegistrySubsystem::FindDescriptor(request.Key);
+		if (!descriptor)
+			continue;
+
+		const EInteractionOutlineLayer layer = GetTopLayer(request.Value);
+		for (const TWeakObjectPtr<UMeshComponent>& mesh : descriptor->Meshes)
+		{
+			EInteractionOutlineLayer& meshLayer = meshes.FindOrAdd(mesh, EInteractionOutlineLayer::None);
+			if (GetLayerPriority(layer) > GetLayerPriority(meshLayer))
+				meshLayer = layer;
+		}
+		// Custom depth is per component, so a single instance is outlined by the material of the instanced mesh
+		if (descriptor->InstancedMesh.IsValid())
+			instances.Add(MakeTuple(descriptor->InstancedMesh, descriptor->InstanceIndex), layer);
+	}
+
+	for (const TPair<TWeakObjectPtr<UMeshComponent>, EInteractionOutlineLayer>& applied : AppliedMeshes)
+		if (!meshes.Contains(applied.Key))
+			if (UMeshComponent* meshComponent = applied.Key.Get())
+				meshComponent->SetRenderCustomDepth(false);
+	for (const TPair<TWeakObjectPtr<UMeshComponent>, EInteractionOutlineLayer>& wanted : meshes)
+	{
+		const EInteractionOutlineLayer* appliedLayer = AppliedMeshes.Find(wanted.Key);
+		if (appliedLayer && *appliedLayer == wanted.Value)
+			continue;
+		if (UMeshComponent* meshComponent = wanted.Key.Get())
+		{
+			meshComponent->SetCustomDepthStencilValue(static_cast<int32>(wanted.Value));
+			if (!appliedLayer)
+				meshComponent->SetRenderCustomDepth(true);
+		}
+	}
+	AppliedMeshes = MoveTemp(meshes);
+
+	for (const auto& applied : AppliedInstances)
+		if (!instances.Contains(applied.Key))
+			if (UInteractableInstancedStaticMeshComponent* instancedMesh = applied.Key.Key.Get())
+				instancedMesh->SetInstanceOutlineStencil(applied.Key.Value, 0);
+	for (const auto& wanted : instances)
+	{
+		const EInteractionOutlineLayer* appliedLayer = AppliedInstances.Find(wanted.Key);
+		if (appliedLayer && *appliedLayer == wanted.Value)
+			continue;
+		if (UInteractableInstancedStaticMeshComponent* instancedMesh = wanted.Key.Key.Get())
+			instancedMesh->SetInstanceOutlineStencil(wanted.Key.Value, static_cast<int32>(wanted.Value));
+	}
+	AppliedInstances = MoveTemp(instances);
+}
+
+EInteractionOutlineLayer UInteractionOutlineSubsystem::GetTopLayer(const FOutlineRequests& LayerRequests)
+{
+	EInteractionOutlineLayer topLayer = EInteractionOutlineLayer::None;
+	for (int32 i = 0; i < NumLayers; ++i)
+	{
+		const EInteractionOutlineLayer layer = static_cast<EInteractionOutlineLayer>(i + 1);
+		if (LayerRequests.Counts[i] > 0 && GetLayerPriority(layer) > GetLayerPriority(topLayer))
+			topLayer = layer;
+	}
+	return topLayer;
+}
+
+int32 UInteractionOutlineSubsystem::GetLayerPriority(EInteractionOutlineLayer Layer)
+{
+	switch (Layer)
+	{
+	case EInteractionOutlineLayer::Focused:
+		return 3;
+	case EInteractionOutlineLayer::Teammate:
+		return 2;
+	case EInteractionOutlineLayer::InRange:
+		return 1;
+	default:
+		return 0;
+	}
+}
+//------------------------------------------------------------------------------------------------------------/UInteractionWidget/------------------------------------------------------------------------------------------------------------
+void UInteractionWidget::StartHoldProgress(float StartTime, float Duration)
+{
+	HoldStartTime = StartTime;
+	HoldDuration = Duration;
+	bHoldInProgress = true;
+}
+
+void UInteractionWidget::StopHoldProgress()
+{
+	bHoldInProgress = false;
+	SharedHoldComponent.Reset();
+	SharedHoldInstance = INDEX_NONE;
+	UpdateProgressBar(0.f);
+}
+
+void UInteractionWidget::SetSharedHoldProgress(UInteractionHoldComponent* HoldComponent, int32 InstanceIndex)
+{
+	SharedHoldComponent = HoldComponent;
+	SharedHoldInstance = InstanceIndex;
+}
+
+void UInteractionWidget::NativeTick(const FGeometry& MyGeometry, float InDeltaTime)
+{
+	Super::NativeTick(MyGeometry, InDeltaTime);
+
+	if (bHoldInProgress && HoldDuration > 0.f)
+	{
+		float progress = (GetWorld()->GetTimeSeconds() - HoldStartTime) / HoldDuration;
+		// Shared progress is ahead of the own one when other instigators hold the same target
+		if (const UInteractionHoldComponent* holdComponent = SharedHoldComponent.Get())
+			progress = FMath::Max(progress, holdComponent->GetHoldProgress(SharedHoldInstance));
+		UpdateProgressBar(FMath::Clamp(progress, 0.f, 1.f));
+	}
+}
+//------------------------------------------------------------------------------------------------------------//------------------------------------------------------------------------------------------------------------
+void UInteractionLocalPlayerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Assets are requested as early as possible to keep loading out of the first interaction and out of respawns
+	FStreamableManager& streamableManager = UAssetManager::GetStreamableManager();
+	if (InteractionWidgetClassPath.IsValid())
+		WidgetClassHandle = streamableManager.RequestAsyncLoad(InteractionWidgetClassPath, FStreamableDelegate::CreateUObject(this, &UInteractionLocalPlayerSubsystem::OnWidgetClassLoaded));
+	else
+		UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: InteractionWidgetClass is not set. Please set it in the config DefaultGame.ini file."));
+
+	if (PostprocessOutliningMaterialPath.IsValid())
+		OutliningMaterialHandle = streamableManager.RequestAsyncLoad(PostprocessOutliningMaterialPath, FStreamableDelegate::CreateUObject(this, &UInteractionLocalPlayerSubsystem::OnOutliningMaterialLoaded));
+	else
+		UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: PostprocessOutliningMaterial is not set. Please set it in the config DefaultGame.ini file."));
+}
+
+void UInteractionLocalPlayerSubsystem::Deinitialize()
+{
+	if (WidgetClassHandle.IsValid())
+		WidgetClassHandle->CancelHandle();
+	if (OutliningMaterialHandle.IsValid())
+		OutliningMaterialHandle->CancelHandle();
+	WidgetClassHandle.Reset();
+	OutliningMaterialHandle.Reset();
+
+	Super::Deinitialize();
+}
+
+UInteractionWidget* UInteractionLocalPlayerSubsystem::GetWidget()
+{
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_GetWidget);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UInteractionLocalPlayerSubsystem::GetWidget);
+
+	if (!InteractionWidget)
+	{
+		if (!WidgetClassHandle.IsValid())
+		{
+			UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: InteractionWidgetClass is not set. Please set it in the config DefaultGame.ini file."));
+			return nullptr;
+		}
+		if (WidgetClassHandle->IsLoadingInProgress())
+		{
+			UE_LOG(LogInteractionSystem, Warning, TEXT("UInteractionLocalPlayerSubsystem: Widget is requested before its class has been loaded. Waiting for it."));
+			WidgetClassHandle->WaitUntilComplete();
+		}
+		TryCreateWidget();
+	}
+	return InteractionWidget;
+}
+
+void UInteractionLocalPlayerSubsystem::OnWidgetClassLoaded()
+{
+	TryCreateWidget();
+}
+
+void UInteractionLocalPlayerSubsystem::TryCreateWidget()
+{
+	if (InteractionWidget || !WidgetClassHandle.IsValid() || !GetWorld())
+		return;
+
+	if (UClass* LoadedObject = Cast<UClass>(WidgetClassHandle->GetLoadedAsset()))
+		InteractionWidget = CreateWidget<UInteractionWidget>(GetWorld(), LoadedObject);
+	else if (WidgetClassHandle->HasLoadCompleted())
+		UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: InteractionWidgetClass can't be loaded. Please check it in the config DefaultGame.ini file."));
+}
+//------------------------------------------------------------------------------------------------------------//------------------------------------------------------------------------------------------------------------
+void UInteractionLocalPlayerSubsystem::PlayerControllerChanged(APlayerController* NewPlayerController)
+{
+	Super::PlayerControllerChanged(NewPlayerController);
+
+	if (NewPlayerController)
+	{
+		NewPlayerController->OnPossessedPawnChanged.AddUniqueDynamic(this, &UInteractionLocalPlayerSubsystem::OnPawnChanged_Callback);
+		// The world may have been unavailable when the widget class has finished loading
+		TryCreateWidget();
+	}
+}
+
+void UInteractionLocalPlayerSubsystem::OnPawnChanged_Callback(APawn* OldPawn, APawn* NewPawn)
+{
+	if (!NewPawn || !OutliningMaterialHandle.IsValid())
+		return;
+
+	if (OutliningMaterialHandle->HasLoadCompleted())
+		ApplyOutliningMaterial(NewPawn, Cast<UMaterialInterface>(OutliningMaterialHandle->GetLoadedAsset()));
+	else
+		PendingOutliningPawn = NewPawn;
+}
+
+void UInteractionLocalPlayerSubsystem::OnOutliningMaterialLoaded()
+{
+	if (APawn* pawn = PendingOutliningPawn.Get())
+		ApplyOutliningMaterial(pawn, Cast<UMaterialInterface>(OutliningMaterialHandle->GetLoadedAsset()));
+	PendingOutliningPawn.Reset();
+}
+
+void UInteractionLocalPlayerSubsystem::ApplyOutliningMaterial(APawn* Pawn, UMaterialInterface* Material) const
+{
+	if (!Material)
+	{
+		UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: PostprocessOutliningMaterial can't be loaded. Please check it in the config DefaultGame.ini file."));
+		return;
+	}
+
+	UCameraComponent* CameraComponent = Pawn->FindComponentByClass<UCameraComponent>();
+	if (!CameraComponent)
+	{
+		UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: Player's Pawn does not have a CameraComponent."));
+		return;
+	}
+
+	// Pawn can be possessed again, the same blendable must not be added twice
+	const bool bAlreadyAdded = CameraComponent->PostProcessSettings.WeightedBlendables.Array.ContainsByPredicate([Material](const FWeightedBlendable& Blendable)
+		{
+			return Blendable.Object == Material;
+		});
+	if (!bAlreadyAdded)
+		CameraComponent->PostProcessSettings.AddBlendable(Material, 1.0f);
+	CameraComponent->PostProcessBlendWeight = 1.0f;
+}
+
+//------------------------------------------------------------------------------------------------------------/FInteractionTargetingParams/------------------------------------------------------------------------------------------------------------
+FBox FInteractionTargetingParams::GetQueryBox(const FVector& Origin, const FVector& Direction) const
+{
+	const FVector coneEnd = Origin + Direction * MaxDistance;
+	const float coneEndRadius = MaxDistance * FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(MaxAngleDegrees, 0.f, 89.f))) + CandidateRadius;
+	return FBox(Origin.ComponentMin(coneEnd), Origin.ComponentMax(coneEnd)).ExpandBy(coneEndRadius);
+}
+
+bool FInteractionTargetingParams::operator==(const FInteractionTargetingParams& Other) const
+{
+	return MaxDistance == Other.MaxDistance
+		&& CandidateRadius == Other.CandidateRadius
+		&& MaxAngleDegrees == Other.MaxAngleDegrees
+		&& AngleWeight == Other.AngleWeight
+		&& DistanceWeight == Other.DistanceWeight
+		&& bRequireLineOfSight == Other.bRequireLineOfSight
+		&& MaxLineOfSightChecks == Other.MaxLineOfSightChecks;
+}
+
+void FInteractionCandidates::Reset(const FVector& InOrigin)
+{
+	Origin = InOrigin;
+	X.Reset();
+	Y.Reset();
+	Z.Reset();
+	Radius.Reset();
+	Handles.Reset();
+	Num = 0;
+}
+
+void FInteractionCandidates::Add(const FInteractableHandle& Handle, const FBox& Bounds)
+{
+	// Relative locations keep float precision in large worlds
+	const FVector center = Bounds.GetCenter() - Origin;
+	X.Add(static_cast<float>(center.X));
+	Y.Add(static_cast<float>(center.Y));
+	Z.Add(static_cast<float>(center.Z));
+	Radius.Add(static_cast<float>(Bounds.GetExtent().Size()));
+	Handles.Add(Handle);
+	++Num;
+}
+
+void FInteractionCandidates::Pad()
+{
+	// Padding is never read back, its scores are ignored
+	const int32 paddedNum = Align(Num, 4);
+	X.SetNumZeroed(paddedNum);
+	Y.SetNumZeroed(paddedNum);
+	Z.SetNumZeroed(paddedNum);
+	Radius.SetNumZeroed(paddedNum);
+	Handles.SetNum(paddedNum);
+}
+//------------------------------------------------------------------------------------------------------------/FInteractableDescriptor/------------------------------------------------------------------------------------------------------------
+FInteractableDescriptor FInteractableDescriptor::Build(const AActor* Actor)
+{
+	FInteractableDescriptor descriptor;
+	descriptor.Type = IInteractable::Execute_GetInteractionType(Actor);
+	descriptor.HoldDuration = IInteractable::Execute_GetHoldDuration(Actor);
+	for (UMeshComponent* mesh : IInteractable::Execute_GetMeshesForOutlining(Actor))
+		if (mesh)
+			descriptor.Meshes.Add(mesh);
+	descriptor.TooltipPlace = IInteractable::Execute_GetTooltipPlace(Actor);
+	descriptor.TooltipText = IInteractable::Execute_GetTooltipText(Actor);
+	descriptor.MaxConcurrentInteractors = IInteractable::Execute_GetMaxConcurrentInteractors(Actor);
+	return descriptor;
+}
+
+FInteractableDescriptor FInteractableDescriptor::BuildForInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex)
+{
+	FInteractableDescriptor descriptor;
+	if (!Component)
+		return descriptor;
+
+	const FInteractableInstanceData data = Component->GetInstanceData(InstanceIndex);
+	descriptor.Type = data.Type;
+	descriptor.HoldDuration = data.HoldDuration;
+	descriptor.TooltipPlace = Component;
+	descriptor.TooltipText = data.TooltipText;
+	descriptor.MaxConcurrentInteractors = data.MaxConcurrentInteractors;
+	descriptor.InstancedMesh = Component;
+	descriptor.InstanceIndex = InstanceIndex;
+	return descriptor;
+}
+//------------------------------------------------------------------------------------------------------------/UInteractableInstancedStaticMeshComponent/------------------------------------------------------------------------------------------------------------
+void UInteractableInstancedStaticMeshComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Instances disabled in the editor are hidden as well
+	for (int32 i = 0; i < InstanceData.Num(); ++i)
+		if (!InstanceData[i].bEnabled && IsValidInstance(i))
+			SetInstanceEnabled(i, false);
+}
+
+int32 UInteractableInstancedStaticMeshComponent::AddInteractableInstance(const FTransform& InstanceTransform, const FInteractableInstanceData& Data, bool bWorldSpace)
+{
+	const int32 instanceIndex = AddInstance(InstanceTransform, bWorldSpace);
+	GetMutableInstanceData(instanceIndex) = Data;
+	GetMutableInstanceData(instanceIndex).bEnabled = true;
+	SetInstanceEnabled(instanceIndex, Data.bEnabled);
+	return instanceIndex;
+}
+
+void UInteractableInstancedStaticMeshComponent::SetInstanceEnabled(int32 InstanceIndex, bool bEnabled)
+{
+	if (!IsValidInstance(InstanceIndex))
+		return;
+
+	GetMutableInstanceData(InstanceIndex).bEnabled = bEnabled;
+
+	// Instance is hidden instead of removed, removal would shift indices of the others
+	FTransform transform;
+	GetInstanceTransform(InstanceIndex, transform);
+	FVector hiddenScale;
+	if (!bEnabled && !HiddenInstanceScales.Contains(InstanceIndex))
+	{
+		HiddenInstanceScales.Add(InstanceIndex, transform.GetScale3D());
+		transform.SetScale3D(FVector::ZeroVector);
+		UpdateInstanceTransform(InstanceIndex, transform, false, true);
+	}
+	else if (bEnabled && HiddenInstanceScales.RemoveAndCopyValue(InstanceIndex, hiddenScale))
+	{
+		transform.SetScale3D(hiddenScale);
+		UpdateInstanceTransform(InstanceIndex, transform, false, true);
+	}
+
+	if (UInteractableRegistrySubsystem* registry = GetRegistry())
+	{
+		if (bEnabled)
+			registry->RegisterInstance(this, InstanceIndex);
+		else registry->UnregisterInstance(this, InstanceIndex);
+	}
+}
+
+void UInteractableInstancedStaticMeshComponent::SetInstanceData(int32 InstanceIndex, const FInteractableInstanceData& Data)
+{
+	if (!IsValidInstance(InstanceIndex))
+		return;
+
+	const bool bWasEnabled = IsInstanceEnabled(InstanceIndex);
+	FInteractableInstanceData& data = GetMutableInstanceData(InstanceIndex);
+	data = Data;
+	data.bEnabled = bWasEnabled;
+	if (Data.bEnabled != bWasEnabled)
+		SetInstanceEnabled(InstanceIndex, Data.bEnabled);
+	else if (UInteractableRegistrySubsystem* registry = GetRegistry())
+		registry->UpdateInstance(this, InstanceIndex);
+}
+
+void UInteractableInstancedStaticMeshComponent::SetInteractableInstanceTransform(int32 InstanceIndex, const FTransform& InstanceTransform, bool bWorldSpace)
+{
+	if (!IsValidInstance(InstanceIndex))
+		return;
+
+	FTransform transform = InstanceTransform;
+	// Hidden instance keeps zero scale until it is enabled
+	if (FVector* hiddenScale = HiddenInstanceScales.Find(InstanceIndex))
+	{
+		*hiddenScale = transform.GetScale3D();
+		transform.SetScale3D(FVector::ZeroVector);
+	}
+	UpdateInstanceTransform(InstanceIndex, transform, bWorldSpace, true);
+
+	if (UInteractableRegistrySubsystem* registry = GetRegistry())
+		registry->UpdateInstance(this, InstanceIndex);
+}
+
+FInteractableInstanceData UInteractableInstancedStaticMeshComponent::GetInstanceData(int32 InstanceIndex) const
+{
+	return InstanceData.IsValidIndex(InstanceIndex) ? InstanceData[InstanceIndex] : DefaultInstanceData;
+}
+
+bool UInteractableInstancedStaticMeshComponent::IsInstanceEnabled(int32 InstanceIndex) const
+{
+	return IsValidInstance(InstanceIndex) && (InstanceData.IsValidIndex(InstanceIndex) ? InstanceData[InstanceIndex].bEnabled : DefaultInstanceData.bEnabled);
+}
+
+FBox UInteractableInstancedStaticMeshComponent::GetInstanceBounds(int32 InstanceIndex) const
+{
+	FTransform transform;
+	if (!GetInstanceTransform(InstanceIndex, transform, true))
+		return FBox(ForceInit);
+	if (const UStaticMesh* mesh = GetStaticMesh())
+		return mesh->GetBounds().GetBox().TransformBy(transform);
+	return FBox(transform.GetLocation(), transform.GetLocation());
+}
+
+void UInteractableInstancedStaticMeshComponent::SetInstanceOutlineStencil(int32 InstanceIndex, int32 StencilValue)
+{
+	if (IsValidInstance(InstanceIndex) && OutlineCustomDataIndex < NumCustomDataFloats)
+		SetCustomDataValue(InstanceIndex, OutlineCustomDataIndex, static_cast<float>(StencilValue), true);
+}
+
+FInteractableInstanceData& UInteractableInstancedStaticMeshComponent::GetMutableInstanceData(int32 InstanceIndex)
+{
+	// Instances without data so far get the default one
+	for (int32 i = InstanceData.Num(); i <= InstanceIndex; ++i)
+		InstanceData.Add(DefaultInstanceData);
+	return InstanceData[InstanceIndex];
+}
+
+UInteractableRegistrySubsystem* UInteractableInstancedStaticMeshComponent::GetRegistry() const
+{
+	const UWorld* world = GetWorld();
+	return world ? world->GetSubsystem<UInteractableRegistrySubsystem>() : nullptr;
+}
+//------------------------------------------------------------------------------------------------------------/UInteractableRegistrySubsystem/------------------------------------------------------------------------------------------------------------
+void UInteractableRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (CellSize <= 0.f)
+	{
+		UE_LOG(LogInteractionSystem, Warning, TEXT("UInteractableRegistrySubsystem: CellSize must be positive. Default value is used."));
+		CellSize = 500.f;
+	}
+
+	UWorld* world = GetWorld();
+	ActorSpawnedHandle = world->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UInteractableRegistrySubsystem::OnActorSpawned));
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UInteractableRegistrySubsystem::OnLevelAdded);
+}
+
+void UInteractableRegistrySubsystem::Deinitialize()
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+
+	for (FEntry& entry : Entries)
+		if (AActor* actor = entry.Actor.Get())
+		{
+			if (USceneComponent* root = actor->GetRootComponent())
+				root->TransformUpdated.Remove(entry.TransformUpdatedHandle);
+			actor->OnEndPlay.RemoveDynamic(this, &UInteractableRegistrySubsystem::OnActorEndPlay);
+		}
+	InteractionStats::ChangeNetDormancy(-GetNumDormantInteractables(), -NumAwakeInteractables);
+	GetWorld()->GetTimerManager().ClearTimer(DormancyTimerHandle);
+	DormancyStates.Empty();
+	NumAwakeInteractables = 0;
+
+	for (const TPair<TObjectKey<AActor>, FInstanceOwner>& instanceOwner : InstanceOwners)
+		if (AActor* actor = instanceOwner.Key.ResolveObjectPtr())
+			if (USceneComponent* root = actor->GetRootComponent())
+				root->TransformUpdated.Remove(instanceOwner.Value.TransformUpdatedHandle);
+	GetWorld()->GetTimerManager().ClearTimer(HistorySampleTimerHandle);
+	Entries.Empty();
+	Descriptors.Empty();
+	EntryIndices.Empty();
+	InstanceOwners.Empty();
+	Cells.Empty();
+	Histories.Empty();
+
+	Super::Deinitialize();
+}
+
+void UInteractableRegistrySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	for (TActorIterator<AActor> it(&InWorld); it; ++it)
+		RegisterInteractable(*it);
+
+	// History is needed only where client requests are validated
+	bRecordHistory = InWorld.GetNetMode() != NM_Client && HistorySampleRate > 0.f && HistoryCapacity > 0 && MaxTrackedInteractables > 0;
+	if (bRecordHistory)
+		InWorld.GetTimerManager().SetTimer(HistorySampleTimerHandle, FTimerDelegate::CreateUObject(this, &UInteractableRegistrySubsystem::SampleHistories), 1.f / HistorySampleRate, true);
+
+	const ENetMode netMode = InWorld.GetNetMode();
+	if (bManageNetDormancy && (netMode == NM_DedicatedServer || netMode == NM_ListenServer))
+	{
+		const float dormancyCheckInterval = FMath::Max(DormancyQuietPeriod * 0.25f, 0.1f); // Interactables fall asleep at most this late after the quiet period
+		InWorld.GetTimerManager().SetTimer(DormancyTimerHandle, FTimerDelegate::CreateUObject(this, &UInteractableRegistrySubsystem::UpdateNetDormancy), dormancyCheckInterval, true);
+	}
+}
+
+bool UInteractableRegistrySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UInteractableRegistrySubsystem::RegisterInteractable(AActor* Actor)
+{
+	if (!IsValid(Actor) || !Actor->Implements<UInteractable>() || EntryIndices.Contains(Actor) || InstanceOwners.Contains(Actor))
+		return;
+
+	if (ShouldManageNetDormancy(Actor))
+		StartManagingNetDormancy(Actor);
+
+	// Instances are the targets, not the actor which owns them
+	if (UInteractableInstancedStaticMeshComponent* instancedMesh = Actor->FindComponentByClass<UInteractableInstancedStaticMeshComponent>())
+	{
+		FInstanceOwner& instanceOwner = InstanceOwners.Add(Actor);
+		instanceOwner.Component = instancedMesh;
+		if (USceneComponent* root = Actor->GetRootComponent())
+			instanceOwner.TransformUpdatedHandle = root->TransformUpdated.AddUObject(this, &UInteractableRegistrySubsystem::OnRootTransformUpdated);
+		Actor->OnEndPlay.AddUniqueDynamic(this, &UInteractableRegistrySubsystem::OnActorEndPlay);
+
+		for (int32 i = 0; i < instancedMesh->GetInstanceCount(); ++i)
+			RegisterInstance(instancedMesh, i);
+		return;
+	}
+
+	FEntry entry;
+	entry.Actor = Actor;
+	entry.Bounds = CalculateBounds(entry);
+	if (USceneComponent* root = Actor->GetRootComponent())
+		entry.TransformUpdatedHandle = root->TransformUpdated.AddUObject(this, &UInteractableRegistrySubsystem::OnRootTransformUpdated);
+	Actor->OnEndPlay.AddUniqueDynamic(this, &UInteractableRegistrySubsystem::OnActorEndPlay);
+
+	const int32 entryIndex = Entries.Add(MoveTemp(entry));
+	Descriptors.Insert(entryIndex, FInteractableDescriptor());
+	EntryIndices.Add(Actor, entryIndex);
+	AddToCells(entryIndex);
+}
+
+void UInteractableRegistrySubsystem::UnregisterInteractable(AActor* Actor)
+{
+	StopManagingNetDormancy(Actor);
+
+	FInstanceOwner instanceOwner;
+	if (InstanceOwners.RemoveAndCopyValue(Actor, instanceOwner))
+	{
+		if (IsValid(Actor))
+		{
+			if (USceneComponent* root = Actor->GetRootComponent())
+				root->TransformUpdated.Remove(instanceOwner.TransformUpdatedHandle);
+			Actor->OnEndPlay.RemoveDynamic(this, &UInteractableRegistrySubsystem::OnActorEndPlay);
+		}
+		for (const int32 entryIndex : instanceOwner.EntryIndices)
+			if (entryIndex != INDEX_NONE)
+				RemoveEntry(entryIndex);
+		return;
+	}
+
+	int32 entryIndex;
+	if (!EntryIndices.RemoveAndCopyValue(Actor, entryIndex))
+		return;
+
+	if (IsValid(Actor))
+	{
+		if (USceneComponent* root = Actor->GetRootComponent())
+			root->TransformUpdated.Remove(Entries[entryIndex].TransformUpdatedHandle);
+		Actor->OnEndPlay.RemoveDynamic(this, &UInteractableRegistrySubsystem::OnActorEndPlay);
+	}
+	RemoveEntry(entryIndex);
+}
+
+void UInteractableRegistrySubsystem::UpdateInteractable(AActor* Actor)
+{
+	if (const int32* entryIndex = EntryIndices.Find(Actor))
+		UpdateEntry(*entryIndex);
+	else if (const FInstanceOwner* instanceOwner = InstanceOwners.Find(Actor))
+		for (const int32 instanceEntryIndex : instanceOwner->EntryIndices)
+			if (instanceEntryIndex != INDEX_NONE)
+				UpdateEntry(instanceEntryIndex);
+}
+
+void UInteractableRegistrySubsystem::BeginNetInteraction(AActor* Actor)
+{
+	FDormancyState* state = DormancyStates.Find(Actor);
+	if (!state || !IsValid(Actor))
+		return;
+
+	++state->NumInteractions;
+	state->LastInteractionTime = GetWorld()->GetTimeSeconds();
+	if (!state->bAwake)
+	{
+		// Awake actor replicates as usual, dormant one is skipped by every net update
+		Actor->SetNetDormancy(DORM_Awake);
+		state->bAwake = true;
+		++NumAwakeInteractables;
+		InteractionStats::ChangeNetDormancy(-1, 1);
+		InteractionStats::RecordDormancyWake();
+	}
+}
+
+void UInteractableRegistrySubsystem::EndNetInteraction(AActor* Actor)
+{
+	if (FDormancyState* state = DormancyStates.Find(Actor))
+	{
+		state->NumInteractions = FMath::Max(state->NumInteractions - 1, 0);
+		state->LastInteractionTime = GetWorld()->GetTimeSeconds();
+	}
+}
+
+bool UInteractableRegistrySubsystem::ShouldManageNetDormancy(const AActor* Actor) const
+{
+	// Only server can change dormancy, standalone game doesn't replicate at all
+	const ENetMode netMode = GetWorld()->GetNetMode();
+	// Opt-in: actor must already be set up to be dormant. Moving actors would silently stop replicating their movement.
+	return bManageNetDormancy
+		&& (netMode == NM_DedicatedServer || netMode == NM_ListenServer)
+		&& Actor->GetIsReplicated()
+		&& (Actor->NetDormancy == DORM_Initial || Actor->NetDormancy == DORM_DormantAll)
+		&& !Actor->IsReplicatingMovement()
+		&& !Actor->IsA<APawn>();
+}
+
+void UInteractableRegistrySubsystem::StartManagingNetDormancy(AActor* Actor)
+{
+	if (DormancyStates.Contains(Actor))
+		return;
+
+	// Actor is already dormant. DORM_Initial one isn't even sent to clients until its first wake, switching it to DORM_DormantAll would open a channel on every connection.
+	FDormancyState& state = DormancyStates.Add(Actor);
+	state.OriginalDormancy = Actor->NetDormancy;
+	InteractionStats::ChangeNetDormancy(1, 0);
+}
+
+void UInteractableRegistrySubsystem::StopManagingNetDormancy(AActor* Actor)
+{
+	FDormancyState state;
+	if (!DormancyStates.RemoveAndCopyValue(Actor, state))
+		return;
+
+	if (state.bAwake)
+	{
+		--NumAwakeInteractables;
+		InteractionStats::ChangeNetDormancy(0, -1);
+	}
+	else
+		InteractionStats::ChangeNetDormancy(-1, 0);
+
+	// Actor which stays in the world gets its own dormancy back. DORM_Initial can't be restored once the actor has been woken, the closest is DORM_DormantAll.
+	if (IsValid(Actor) && !Actor->IsActorBeingDestroyed())
+	{
+		ENetDormancy dormancy = state.OriginalDormancy;
+		if (dormancy == DORM_Initial && Actor->NetDormancy != DORM_Initial)
+			dormancy = DORM_DormantAll;
+		if (Actor->NetDormancy != dormancy)
+			Actor->SetNetDormancy(dormancy);
+	}
+}
+
+void UInteractableRegistrySubsystem::UpdateNetDormancy()
+{
+	const float now = GetWorld()->GetTimeSeconds();
+	for (TPair<TObjectKey<AActor>, FDormancyState>& pair : DormancyStates)
+	{
+		FDormancyState& state = pair.Value;
+		if (!state.bAwake || state.NumInteractions > 0 || now - state.LastInteractionTime < DormancyQuietPeriod)
+			continue;
+
+		// Channel is closed only after the last changes have been acknowledged
+		if (AActor* actor = pair.Key.ResolveObjectPtr())
+			actor->SetNetDormancy(DORM_DormantAll);
+		state.bAwake = false;
+		--NumAwakeInteractables;
+		InteractionStats::ChangeNetDormancy(1, -1);
+	}
+}
+
+void UInteractableRegistrySubsystem::RegisterInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex)
+{
+	AActor* owner = Component ? Component->GetOwner() : nullptr;
+	if (!IsValid(owner) || !owner->Implements<UInteractable>() || !Component->IsInstanceEnabled(InstanceIndex))
+		return;
+
+	FInstanceOwner* instanceOwner = InstanceOwners.Find(owner);
+	if (!instanceOwner)
+	{
+		// Owner registered before the component was added becomes an owner of instances, which registers all of them
+		UnregisterInteractable(owner);
+		RegisterInteractable(owner);
+		return;
+	}
+	if (instanceOwner->Component != Component)
+	{
+		UE_LOG(LogInteractionSystem, Warning, TEXT("UInteractableRegistrySubsystem: %s has more than one InteractableInstancedStaticMeshComponent, only the first one is registered"), *owner->GetName());
+		return;
+	}
+
+	for (int32 i = instanceOwner->EntryIndices.Num(); i <= InstanceIndex; ++i)
+		instanceOwner->EntryIndices.Add(INDEX_NONE);
+	if (instanceOwner->EntryIndices[InstanceIndex] != INDEX_NONE)
+		return;
+
+	FEntry entry;
+	entry.Actor = owner;
+	entry.InstancedMesh = Component;
+	entry.InstanceIndex = InstanceIndex;
+	entry.Bounds = CalculateBounds(entry);
+
+	const int32 entryIndex = Entries.Add(MoveTemp(entry));
+	Descriptors.Insert(entryIndex, FInteractableDescriptor());
+	instanceOwner->EntryIndices[InstanceIndex] = entryIndex;
+	AddToCells(entryIndex);
+}
+
+void UInteractableRegistrySubsystem::UnregisterInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex)
+{
+	const int32 entryIndex = FindEntryIndex(FInteractableHandle(Component ? Component->GetOwner() : nullptr, InstanceIndex));
+	if (entryIndex == INDEX_NONE)
+		return;
+
+	InstanceOwners.FindChecked(Component->GetOwner()).EntryIndices[InstanceIndex] = INDEX_NONE;
+	RemoveEntry(entryIndex);
+}
+
+void UInteractableRegistrySubsystem::UpdateInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex)
+{
+	const int32 entryIndex = FindEntryIndex(FInteractableHandle(Component ? Component->GetOwner() : nullptr, InstanceIndex));
+	if (entryIndex == INDEX_NONE)
+		return;
+
+	Entries[entryIndex].bDescriptorDirty = true;
+	UpdateEntry(entryIndex);
+}
+
+const FInteractableDescriptor* UInteractableRegistrySubsystem::GetDescriptor(const FInteractableHandle& Handle)
+{
+	const int32 entryIndex = FindEntryIndex(Handle);
+	if (entryIndex == INDEX_NONE)
+		return nullptr;
+
+	FEntry& entry = Entries[entryIndex];
+	FInteractableDescriptor& descriptor = Descriptors[entryIndex];
+	if (entry.bDescriptorDirty)
+	{
+		descriptor = entry.InstanceIndex != INDEX_NONE ? FInteractableDescriptor::BuildForInstance(entry.InstancedMesh.Get(), entry.InstanceIndex) : FInteractableDescriptor::Build(entry.Actor.Get());
+		entry.bDescriptorDirty = false;
+	}
+	return &descriptor;
+}
+
+void UInteractableRegistrySubsystem::InvalidateDescriptor(AActor* Actor)
+{
+	if (const int32* entryIndex = EntryIndices.Find(Actor))
+		Entries[*entryIndex].bDescriptorDirty = true;
+	else if (const FInstanceOwner* instanceOwner = InstanceOwners.Find(Actor))
+		for (const int32 instanceEntryIndex : instanceOwner->EntryIndices)
+			if (instanceEntryIndex != INDEX_NONE)
+				Entries[instanceEntryIndex].bDescriptorDirty = true;
+}
+
+const FInteractableDescriptor* UInteractableRegistrySubsystem::FindDescriptor(const FInteractableHandle& Handle)
+{
+	if (const AActor* actor = Handle.GetActor())
+		if (UInteractableRegistrySubsystem* registry = actor->GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>())
+			return registry->GetDescriptor(Handle);
+	return nullptr;
+}
+
+void UInteractableRegistrySubsystem::GatherCandidates(const FBox& Box, const AActor* IgnoredActor, FInteractionCandidates& OutCandidates, TOptional<float> RewindTime) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_GatherCandidates);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UInteractableRegistrySubsystem::GatherCandidates);
+
+	const FIntVector minCell = GetCell(Box.Min);
+	const FIntVector maxCell = GetCell(Box.Max);
+	const int32 firstCandidate = OutCandidates.Num;
+	// Moving interactables could be in other cells at the rewind time, so all of them are tested apart from the grid
+	const bool bRewind = RewindTime.IsSet() && Histories.Num() > 0;
+	const float rewindTime = bRewind ? ClampRewindTime(RewindTime.GetValue()) : 0.f;
+	++QueryStamp;
+
+	for (int32 x = minCell.X; x <= maxCell.X; ++x)
+		for (int32 y = minCell.Y; y <= maxCell.Y; ++y)
+			for (int32 z = minCell.Z; z <= maxCell.Z; ++z)
+			{
+				const FCell* cell = Cells.Find(FIntVector(x, y, z));
+				if (!cell)
+					continue;
+
+				for (const int32 entryIndex : cell->EntryIndices)
+				{
+					const FEntry& entry = Entries[entryIndex];
+					if (entry.QueryStamp == QueryStamp)
+						continue;
+					entry.QueryStamp = QueryStamp;
+
+					if (!entry.Bounds.Intersect(Box) || (bRewind && entry.HistoryIndex != INDEX_NONE))
+						continue;
+
+					const AActor* actor = entry.Actor.Get();
+					if (actor && actor != IgnoredActor)
+						OutCandidates.Add(FInteractableHandle(actor, entry.InstanceIndex), entry.Bounds);
+				}
+			}
+
+	if (bRewind)
+		for (const FBoundsHistory& history : Histories)
+		{
+			const FEntry& entry = Entries[history.EntryIndex];
+			const FBox bounds = GetRewoundBounds(entry, rewindTime);
+			const AActor* actor = entry.Actor.Get();
+			if (actor && actor != IgnoredActor && bounds.Intersect(Box))
+				OutCandidates.Add(FInteractableHandle(actor, entry.InstanceIndex), bounds);
+		}
+	InteractionStats::RecordCandidates(OutCandidates.Num - firstCandidate);
+}
+
+bool UInteractableRegistrySubsystem::GetBoundsAtTime(const FInteractableHandle& Handle, float Time, FBox& OutBounds) const
+{
+	const int32 entryIndex = FindEntryIndex(Handle);
+	if (entryIndex == INDEX_NONE)
+		return false;
+
+	OutBounds = GetRewoundBounds(Entries[entryIndex], ClampRewindTime(Time));
+	return true;
+}
+
+void UInteractableRegistrySubsystem::RecordMovement(int32 EntryIndex, const FVector& OldCenter)
+{
+	FEntry& entry = Entries[EntryIndex];
+	const float now = GetWorld()->GetTimeSeconds();
+	if (entry.HistoryIndex == INDEX_NONE)
+	{
+		// Interactables above the limit are validated at their present location
+		if (Histories.Num() >= MaxTrackedInteractables)
+			return;
+
+		FBoundsHistory history;
+		history.EntryIndex = EntryIndex;
+		history.Samples.Reserve(HistoryCapacity);
+		entry.HistoryIndex = Histories.Add(MoveTemp(history));
+	}
+
+	FBoundsHistory& history = Histories[entry.HistoryIndex];
+	// Interactable has been at rest at the old location until now, otherwise it would be interpolated over the rest
+	if (!history.bMovedSinceSample && (history.NewestSample == INDEX_NONE || now - history.Samples[history.NewestSample].Time > 1.f / HistorySampleRate))
+		AddHistorySample(history, now, OldCenter);
+	history.bMovedSinceSample = true;
+	history.LastMoveTime = now;
+}
+
+void UInteractableRegistrySubsystem::AddHistorySample(FBoundsHistory& History, float Time, const FVector& Center) const
+{
+	if (History.Samples.Num() < HistoryCapacity)
+		History.NewestSample = History.Samples.Add({ Time, Center });
+	else
+	{
+		History.NewestSample = (History.NewestSample + 1) % History.Samples.Num();
+		History.Samples[History.NewestSample] = { Time, Center };
+	}
+}
+
+void UInteractableRegistrySubsystem::SampleHistories()
+{
+	const float now = GetWorld()->GetTimeSeconds();
+	// After this time at rest no query can be rewound to a moment when the interactable was moving
+	const float maxRestTime = HistoryCapacity / HistorySampleRate + MaxRewindTime;
+
+	for (auto it = Histories.CreateIterator(); it; ++it)
+	{
+		FBoundsHistory& history = *it;
+		if (history.bMovedSinceSample)
+		{
+			AddHistorySample(history, now, Entries[history.EntryIndex].Bounds.GetCenter());
+			history.bMovedSinceSample = false;
+		}
+		else if (now - history.LastMoveTime > maxRestTime)
+		{
+			Entries[history.EntryIndex].HistoryIndex = INDEX_NONE;
+			it.RemoveCurrent();
+		}
+	}
+}
+
+FBox UInteractableRegistrySubsystem::GetRewoundBounds(const FEntry& Entry, float Time) const
+{
+	if (Entry.HistoryIndex == INDEX_NONE)
+		return Entry.Bounds;
+
+	const FBoundsHistory& history = Histories[Entry.HistoryIndex];
+	if (Time >= history.LastMoveTime || history.NewestSample == INDEX_NONE)
+		return Entry.Bounds;
+
+	// Walk from the present location to older samples until the pair around Time is found
+	const FVector currentCenter = Entry.Bounds.GetCenter();
+	FHistorySample newer = { history.LastMoveTime, currentCenter };
+	const int32 numSamples = history.Samples.Num();
+	for (int32 i = 0; i < numSamples; ++i)
+	{
+		const FHistorySample& older = history.Samples[(history.NewestSample - i + numSamples) % numSamples];
+		// Sample taken after the last move has the present location
+		if (older.Time >= newer.Time)
+			continue;
+
+		if (Time >= older.Time)
+		{
+			const float alpha = (Time - older.Time) / (newer.Time - older.Time);
+			return Entry.Bounds.ShiftBy(FMath::Lerp(older.Center, newer.Center, alpha) - currentCenter);
+		}
+		newer = older;
+	}
+	// Older than the history, the oldest known location is the best guess
+	return Entry.Bounds.ShiftBy(newer.Center - currentCenter);
+}
+
+float UInteractableRegistrySubsystem::ClampRewindTime(float Time) const
+{
+	const float now = GetWorld()->GetTimeSeconds();
+	return FMath::Clamp(Time, now - MaxRewindTime, now);
+}
+
+FIntVector UInteractableRegistrySubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt32(Location.X / CellSize),
+		FMath::FloorToInt32(Location.Y / CellSize),
+		FMath::FloorToInt32(Location.Z / CellSize));
+}
+
+FBox UInteractableRegistrySubsystem::CalculateBounds(const FEntry& Entry)
+{
+	FBox bounds(ForceInit);
+	if (Entry.InstanceIndex != INDEX_NONE)
+	{
+		if (const UInteractableInstancedStaticMeshComponent* instancedMesh = Entry.InstancedMesh.Get())
+			bounds = instancedMesh->GetInstanceBounds(Entry.InstanceIndex);
+	}
+	// Only colliding components are taken into account, as the overlap query did before
+	else if (const AActor* actor = Entry.Actor.Get())
+		bounds = actor->GetComponentsBoundingBox();
+
+	if (!bounds.IsValid)
+		if (const AActor* actor = Entry.Actor.Get())
+			bounds = FBox(actor->GetActorLocation(), actor->GetActorLocation());
+	return bounds;
+}
+
+int32 UInteractableRegistrySubsystem::FindEntryIndex(const FInteractableHandle& Handle) const
+{
+	if (!Handle.IsInstance())
+	{
+		const int32* entryIndex = EntryIndices.Find(Handle.GetActor());
+		return entryIndex ? *entryIndex : INDEX_NONE;
+	}
+	const FInstanceOwner* instanceOwner = InstanceOwners.Find(Handle.GetActor());
+	return instanceOwner && instanceOwner->EntryIndices.IsValidIndex(Handle.InstanceIndex) ? instanceOwner->EntryIndices[Handle.InstanceIndex] : INDEX_NONE;
+}
+
+void UInteractableRegistrySubsystem::UpdateEntry(int32 EntryIndex)
+{
+	FEntry& entry = Entries[EntryIndex];
+	const FVector oldCenter = entry.Bounds.GetCenter();
+	entry.Bounds = CalculateBounds(entry);
+	// Data-only updates, e.g. of instance data, must not take a history slot
+	if (bRecordHistory && !entry.Bounds.GetCenter().Equals(oldCenter))
+		RecordMovement(EntryIndex, oldCenter);
+
+	// Move between cells only if the covered cells have changed
+	if (GetCell(entry.Bounds.Min) != entry.MinCell || GetCell(entry.Bounds.Max) != entry.MaxCell)
+	{
+		RemoveFromCells(EntryIndex);
+		AddToCells(EntryIndex);
+	}
+	else
+		MarkCellsChanged(entry.MinCell, entry.MaxCell);
+}
+
+void UInteractableRegistrySubsystem::RemoveEntry(int32 EntryIndex)
+{
+	RemoveFromCells(EntryIndex);
+	if (Entries[EntryIndex].HistoryIndex != INDEX_NONE)
+		Histories.RemoveAt(Entries[EntryIndex].HistoryIndex);
+	Entries.RemoveAt(EntryIndex);
+	Descriptors.RemoveAt(EntryIndex);
+}
+
+void UInteractableRegistrySubsystem::AddToCells(int32 EntryIndex)
+{
+	FEntry& entry = Entries[EntryIndex];
+	entry.MinCell = GetCell(entry.Bounds.Min);
+	entry.MaxCell = GetCell(entry.Bounds.Max);
+
+	for (int32 x = entry.MinCell.X; x <= entry.MaxCell.X; ++x)
+		for (int32 y = entry.MinCell.Y; y <= entry.MaxCell.Y; ++y)
+			for (int32 z = entry.MinCell.Z; z <= entry.MaxCell.Z; ++z)
+				Cells.FindOrAdd(FIntVector(x, y, z)).EntryIndices.Add(EntryIndex);
+	MarkCellsChanged(entry.MinCell, entry.MaxCell);
+}
+
+void UInteractableRegistrySubsystem::RemoveFromCells(int32 EntryIndex)
+{
+	const FEntry& entry = Entries[EntryIndex];
+
+	for (int32 x = entry.MinCell.X; x <= entry.MaxCell.X; ++x)
+		for (int32 y = entry.MinCell.Y; y <= entry.MaxCell.Y; ++y)
+			for (int32 z = entry.MinCell.Z; z <= entry.MaxCell.Z; ++z)
+				// Empty cells are kept, otherwise their revision would be lost
+				if (FCell* cell = Cells.Find(FIntVector(x, y, z)))
+					cell->EntryIndices.RemoveSingleSwap(EntryIndex);
+	MarkCellsChanged(entry.MinCell, entry.MaxCell);
+}
+
+void UInteractableRegistrySubsystem::MarkCellsChanged(const FIntVector& MinCell, const FIntVector& MaxCell)
+{
+	++Revision;
+	for (int32 x = MinCell.X; x <= MaxCell.X; ++x)
+		for (int32 y = MinCell.Y; y <= MaxCell.Y; ++y)
+			for (int32 z = MinCell.Z; z <= MaxCell.Z; ++z)
+				if (FCell* cell = Cells.Find(FIntVector(x, y, z)))
+					cell->Revision = Revision;
+}
+
+uint64 UInteractableRegistrySubsystem::GetRevisionInBox(const FBox& Box) const
+{
+	const FIntVector minCell = GetCell(Box.Min);
+	const FIntVector maxCell = GetCell(Box.Max);
+
+	uint64 revision = 0;
+	for (int32 x = minCell.X; x <= maxCell.X; ++x)
+		for (int32 y = minCell.Y; y <= maxCell.Y; ++y)
+			for (int32 z = minCell.Z; z <= maxCell.Z; ++z)
+				if (const FCell* cell = Cells.Find(FIntVector(x, y, z)))
+					revision = FMath::Max(revision, cell->Revision);
+	return revision;
+}
+
+void UInteractableRegistrySubsystem::OnActorSpawned(AActor* Actor)
+{
+	RegisterInteractable(Actor);
+}
+
+void UInteractableRegistrySubsystem::OnLevelAdded(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld() && Level)
+		for (AActor* actor : Level->Actors)
+			RegisterInteractable(actor);
+}
+
+void UInteractableRegistrySubsystem::OnRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	UpdateInteractable(UpdatedComponent->GetOwner());
+}
+
+void UInteractableRegistrySubsystem::OnActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	UnregisterInteractable(Actor);
+}
+//------------------------------------------------------------------------------------------------------------/UInteractionTargetingSubsystem/------------------------------------------------------------------------------------------------------------
+FInteractableHandle UInteractionTargetingSubsystem::GetInteractionTarget(const AActor* AvatarActor, const FInteractionTargetingParams& Params, uint32 MaxFrameAge)
+{
+	if (!AvatarActor)
+		return FInteractableHandle();
+
+	FCachedTarget& cached = CachedTargets.FindOrAdd(AvatarActor);
+	if (!cached.Camera.IsValid() || cached.Avatar.Get() != AvatarActor)
+	{
+		cached = FCachedTarget();
+		cached.Avatar = AvatarActor;
+		cached.Camera = AvatarActor->FindComponentByClass<UCameraComponent>();
+	}
+
+	const UCameraComponent* camera = cached.Camera.Get();
+	if (!camera)
+		return UGAInteraction::GetInteractionTarget(AvatarActor, Params);
+
+	const FTransform cameraTransform = camera->GetComponentTransform();
+	if (cached.FrameNumber != 0 && GFrameCounter - cached.FrameNumber <= MaxFrameAge && cached.Params == Params && cached.CameraTransform.Equals(cameraTransform))
+		return cached.Target;
+
+	cached.Target = UGAInteraction::GetInteractionTarget(AvatarActor, Params);
+	cached.Params = Params;
+	cached.CameraTransform = cameraTransform;
+	cached.FrameNumber = GFrameCounter;
+	return cached.Target;
+}
+
+void UInteractionTargetingSubsystem::InvalidateTarget(const AActor* AvatarActor)
+{
+	if (FCachedTarget* cached = CachedTargets.Find(AvatarActor))
+		cached->FrameNumber = 0;
+}
+
+void UInteractionTargetingSubsystem::RequestInteractionTargetAsync(const AActor* AvatarActor, const FInteractionTargetingParams& Params, FOnInteractionTargetResolved OnResolved)
+{
+	// Callers rely on the result never arriving inside the request, answers known immediately are deferred to the next frame
+	if (!AvatarActor)
+	{
+		DeferResult(MoveTemp(OnResolved), FInteractableHandle());
+		return;
+	}
+
+	if (FPendingAsyncQuery* pending = PendingAsyncQueries.Find(AvatarActor))
+	{
+		if (pending->Params == Params)
+			pending->Callbacks.Add(MoveTemp(OnResolved));
+		else
+			// Only one query per avatar can be in flight, a query with other params is run synchronously
+			DeferResult(MoveTemp(OnResolved), GetInteractionTarget(AvatarActor, Params));
+		return;
+	}
+
+	const UCameraComponent* camera = AvatarActor->FindComponentByClass<UCameraComponent>();
+	FVector origin;
+	FRankedInteractionCandidates ranked;
+	if (!camera || !UGAInteraction::RankInteractionCandidates(AvatarActor, Params, origin, ranked))
+	{
+		DeferResult(MoveTemp(OnResolved), FInteractableHandle());
+		return;
+	}
+
+	FPendingAsyncQuery& pending = PendingAsyncQueries.Add(AvatarActor);
+	pending.Avatar = AvatarActor;
+	pending.Params = Params;
+	pending.CameraTransform = camera->GetComponentTransform();
+	pending.Origin = origin;
+	pending.Candidates = MoveTemp(ranked);
+	pending.FrameNumber = GFrameCounter;
+	pending.Callbacks.Add(MoveTemp(OnResolved));
+
+	// Scoring has already been done, only line of sight needs the physics scene. Without traces the query is resolved by the next tick.
+	if (pending.Candidates.Num() == 0 || !Params.bRequireLineOfSight)
+	{
+		pending.bResolved = true;
+		pending.ResolvedTarget = pending.Candidates.Num() > 0 ? pending.Candidates[0].Handle : FInteractableHandle();
+	}
+	else
+		StartLineOfSightTrace(AvatarActor, pending);
+}
+
+void UInteractionTargetingSubsystem::DeferResult(FOnInteractionTargetResolved&& OnResolved, const FInteractableHandle& Target)
+{
+	FDeferredResult& deferred = DeferredResults.AddDefaulted_GetRef();
+	deferred.Callback = MoveTemp(OnResolved);
+	deferred.Target = Target;
+	deferred.FrameNumber = GFrameCounter;
+}
+
+void UInteractionTargetingSubsystem::StartLineOfSightTrace(TObjectKey<AActor> AvatarKey, const FPendingAsyncQuery& Pending)
+{
+	FCollisionQueryParams queryParams;
+	queryParams.AddIgnoredActor(Pending.Avatar.Get());
+	FTraceDelegate traceDelegate = FTraceDelegate::CreateWeakLambda(this, [this, AvatarKey](const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+		{
+			OnAsyncTraceCompleted(AvatarKey, TraceDatum);
+		});
+	InteractionStats::RecordLineOfSightTrace();
+	GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Pending.Origin, Pending.Candidates[Pending.CandidateIndex].Location, ECC_Visibility, queryParams, FCollisionResponseParams::DefaultResponseParam, &traceDelegate);
+}
+
+void UInteractionTargetingSubsystem::OnAsyncTraceCompleted(TObjectKey<AActor> AvatarKey, FTraceDatum& TraceDatum)
+{
+	FPendingAsyncQuery* pending = PendingAsyncQueries.Find(AvatarKey);
+	if (!pending)
+		return;
+
+	// Same condition as in UGAInteraction::HasLineOfSight
+	const FInteractionCandidate& candidate = pending->Candidates[pending->CandidateIndex];
+	const bool bBlocked = TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit && !UGAInteraction::IsHitOnTarget(TraceDatum.OutHits[0], candidate.Handle);
+	if (!bBlocked)
+	{
+		ResolveAsyncQuery(AvatarKey, candidate.Handle);
+		return;
+	}
+
+	if (++pending->CandidateIndex < pending->Candidates.Num() && pending->Avatar.IsValid())
+		StartLineOfSightTrace(AvatarKey, *pending);
+	else
+		ResolveAsyncQuery(AvatarKey, FInteractableHandle());
+}
+
+void UInteractionTargetingSubsystem::ResolveAsyncQuery(TObjectKey<AActor> AvatarKey, const FInteractableHandle& Target)
+{
+	FPendingAsyncQuery pending;
+	if (!PendingAsyncQueries.RemoveAndCopyValue(AvatarKey, pending))
+		return;
+
+	// Result of a query whose avatar is gone is empty
+	const FInteractableHandle target = pending.Avatar.IsValid() ? Target : FInteractableHandle();
+	if (const AActor* avatar = pending.Avatar.Get())
+	{
+		InteractionStats::RecordQuery(target.IsValid());
+
+		// Result describes the camera pose of the frame the query was started in
+		FCachedTarget& cached = CachedTargets.FindOrAdd(AvatarKey);
+		cached.Avatar = avatar;
+		cached.Camera = avatar->FindComponentByClass<UCameraComponent>();
+		cached.Target = target;
+		cached.Params = pending.Params;
+		cached.CameraTransform = pending.CameraTransform;
+		cached.FrameNumber = pending.FrameNumber;
+	}
+
+	for (FOnInteractionTargetResolved& callback : pending.Callbacks)
+		callback.ExecuteIfBound(target);
+}
+
+void UInteractionTargetingSubsystem::Tick(float DeltaTime)
+{
+	InteractionStats::RecordFrame();
+
+	const uint64 pruneFrameAge = 300; // Entries unused for this many frames are removed
+	const uint64 asyncQueryTimeoutFrames = 30; // Async queries without result after this many frames are dropped
+
+	// Results known when they were requested, only those of previous frames. Callbacks may request again.
+	TArray<FDeferredResult> deferredResults = MoveTemp(DeferredResults);
+	DeferredResults.Reset();
+	for (FDeferredResult& deferred : deferredResults)
+		if (deferred.FrameNumber < GFrameCounter)
+			deferred.Callback.ExecuteIfBound(deferred.Target);
+		else DeferredResults.Add(MoveTemp(deferred));
+
+	TArray<TObjectKey<AActor>, TInlineAllocator<8>> resolvedQueries;
+	for (const TPair<TObjectKey<AActor>, FPendingAsyncQuery>& pending : PendingAsyncQueries)
+		if (pending.Value.bResolved && pending.Value.FrameNumber < GFrameCounter)
+			resolvedQueries.Add(pending.Key);
+	for (const TObjectKey<AActor>& avatarKey : resolvedQueries)
+		if (const FPendingAsyncQuery* pending = PendingAsyncQueries.Find(avatarKey))
+			ResolveAsyncQuery(avatarKey, pending->ResolvedTarget);
+
+	for (auto it = PendingAsyncQueries.CreateIterator(); it; ++it)
+		if (GFrameCounter - it.Value().FrameNumber > asyncQueryTimeoutFrames)
+			it.RemoveCurrent();
+
+	if (GFrameCounter % pruneFrameAge == 0)
+		for (auto it = CachedTargets.CreateIterator(); it; ++it)
+			if (!it.Value().Avatar.IsValid() || GFrameCounter - it.Value().FrameNumber > pruneFrameAge)
+				it.RemoveCurrent();
+}
+
+TStatId UInteractionTargetingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UInteractionTargetingSubsystem, STATGROUP_Tickables);
+}
+
+bool UInteractionTargetingSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+//------------------------------------------------------------------------------------------------------------/UInteractionArbiterSubsystem/------------------------------------------------------------------------------------------------------------
+void UInteractionArbiterSubsystem::SubmitRequest(const UGAInteraction* Ability, const AActor* AvatarActor, const AActor* Player, const FInteractableHandle& Target, const FInteractionTargetingParams& Params, FOnInteractionArbitrated OnArbitrated)
+{
+	// Spam is dropped before it costs a query
+	if (!ConsumeRequestToken(Player))
+	{
+		INC_DWORD_STAT(STAT_Interaction_RateLimited);
+		UE_LOG(LogInteractionSystem, Verbose, TEXT("UInteractionArbiterSubsystem: Request of %s is rate-limited"), *GetNameSafe(Player));
+		OnArbitrated.ExecuteIfBound(EInteractionArbitrationResult::RateLimited, FInteractableHandle());
+		return;
+	}
+
+	FRequest& request = PendingRequests.AddDefaulted_GetRef();
+	request.Ability = Ability;
+	request.Avatar = AvatarActor;
+	request.Target = Target;
+	request.bHasTarget = Target.IsValid();
+	request.Params = Params;
+	request.OnArbitrated = MoveTemp(OnArbitrated);
+}
+
+void UInteractionArbiterSubsystem::ReleaseSlot(const UGAInteraction* Ability, const FInteractableHandle& Target)
+{
+	// Weak pointer of the handle keeps its hash after the target is destroyed, so the slot is still found
+	if (TArray<TWeakObjectPtr<const UGAInteraction>>* interactors = Interactors.Find(Target))
+		interactors->RemoveSingleSwap(Ability);
+}
+
+int32 UInteractionArbiterSubsystem::GetNumInteractors(const FInteractableHandle& Target) const
+{
+	const TArray<TWeakObjectPtr<const UGAInteraction>>* interactors = Interactors.Find(Target);
+	if (!interactors)
+		return 0;
+
+	int32 numInteractors = 0;
+	for (const TWeakObjectPtr<const UGAInteraction>& interactor : *interactors)
+		if (interactor.IsValid())
+			++numInteractors;
+	return numInteractors;
+}
+
+bool UInteractionArbiterSubsystem::ConsumeRequestToken(const AActor* Player)
+{
+	if (!Player || RequestsPerSecond <= 0.f)
+		return true;
+
+	const double now = GetWorld()->GetRealTimeSeconds();
+	const float burst = FMath::Max(RequestBurst, 1.f);
+	FRequestBucket* bucket = RequestBuckets.Find(Player);
+	if (!bucket)
+	{
+		bucket = &RequestBuckets.Add(Player);
+		bucket->Tokens = burst;
+		bucket->LastRefillTime = now;
+	}
+
+	bucket->Tokens = FMath::Min(burst, bucket->Tokens + static_cast<float>(now - bucket->LastRefillTime) * RequestsPerSecond);
+	bucket->LastRefillTime = now;
+	if (bucket->Tokens < 1.f)
+		return false;
+	bucket->Tokens -= 1.f;
+	return true;
+}
+
+void UInteractionArbiterSubsystem::Tick(float DeltaTime)
+{
+	const uint64 pruneFrameInterval = 300; // Destroyed targets and full buckets are removed this often
+
+	if (GFrameCounter % pruneFrameInterval == 0)
+	{
+		for (auto it = Interactors.CreateIterator(); it; ++it)
+		{
+			it.Value().RemoveAllSwap([](const TWeakObjectPtr<const UGAInteraction>& Interactor) { return !Interactor.IsValid(); });
+			if (it.Value().Num() == 0 || !it.Key().IsValid())
+				it.RemoveCurrent();
+		}
+
+		// Full bucket is the same as no bucket
+		const double now = GetWorld()->GetRealTimeSeconds();
+		for (auto it = RequestBuckets.CreateIterator(); it; ++it)
+			if (it.Value().Tokens + static_cast<float>(now - it.Value().LastRefillTime) * RequestsPerSecond >= RequestBurst)
+				it.RemoveCurrent();
+	}
+
+	if (PendingRequests.Num() == 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_Interaction_Arbitration);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UInteractionArbiterSubsystem::Tick);
+
+	// Callbacks can submit new requests, they are handled in the next frame
+	TArray<FRequest> requests = MoveTemp(PendingRequests);
+	PendingRequests.Reset();
+
+	// Targets of the frame are chosen together before any request is resolved. Every avatar still runs its own query, only requests of the same avatar share it through the targeting cache.
+	UInteractionTargetingSubsystem* targeting = GetWorld()->GetSubsystem<UInteractionTargetingSubsystem>();
+	UInteractableRegistrySubsystem* registry = GetWorld()->GetSubsystem<UInteractableRegistrySubsystem>();
+	const float now = GetWorld()->GetTimeSeconds();
+	TArray<double> distancesSquared;
+	distancesSquared.SetNumZeroed(requests.Num());
+	for (int32 i = 0; i < requests.Num(); ++i)
+	{
+		FRequest& request = requests[i];
+		const AActor* avatar = request.Avatar.Get();
+		if (!avatar)
+		{
+			request.Target = FInteractableHandle();
+			continue;
+		}
+		if (!request.bHasTarget)
+			request.Target = targeting ? targeting->GetInteractionTarget(avatar, request.Params) : UGAInteraction::GetInteractionTarget(avatar, request.Params);
+		// Instances of one actor are far apart, so the distance is measured to the bounds of the target
+		FBox targetBounds;
+		if (registry && registry->GetBoundsAtTime(request.Target, now, targetBounds))
+			distancesSquared[i] = FVector::DistSquared(avatar->GetActorLocation(), targetBounds.GetCenter());
+	}
+
+	// Requests for the same target are resolved together, closest instigator first, instead of first come first served
+	TArray<int32> order;
+	order.Reserve(requests.Num());
+	for (int32 i = 0; i < requests.Num(); ++i)
+		order.Add(i);
+	order.Sort([&requests, &distancesSquared](int32 A, int32 B)
+		{
+			const FInteractableHandle& targetA = requests[A].Target;
+			const FInteractableHandle& targetB = requests[B].Target;
+			if (targetA.GetActor() != targetB.GetActor())
+				return targetA.GetActor() < targetB.GetActor();
+			if (targetA.InstanceIndex != targetB.InstanceIndex)
+				return targetA.InstanceIndex < targetB.InstanceIndex;
+			return distancesSquared[A] < distancesSquared[B];
+		});
+
+	TArray<EInteractionArbitrationResult> results;
+	results.Init(EInteractionArbitrationResult::NoTarget, requests.Num());
+	for (int32 groupStart = 0, groupEnd = 0; groupStart < order.Num(); groupStart = groupEnd)
+	{
+		const FInteractableHandle target = requests[order[groupStart]].Target;
+		groupEnd = groupStart + 1;
+		while (groupEnd < order.Num() && requests[order[groupEnd]].Target == target)
+			++groupEnd;
+		if (!target.IsValid())
+			continue;
+
+		const FInteractableDescriptor* descriptor = registry ? registry->GetDescriptor(target) : nullptr;
+		const int32 maxInteractors = descriptor ? descriptor->MaxConcurrentInteractors : 0;
+		TArray<TWeakObjectPtr<const UGAInteraction>>& interactors = Interactors.FindOrAdd(target);
+		interactors.RemoveAllSwap([](const TWeakObjectPtr<const UGAInteraction>& Interactor) { return !Interactor.IsValid(); });
+
+		for (int32 i = groupStart; i < groupEnd; ++i)
+		{
+			const FRequest& request = requests[order[i]];
+			if (!request.Ability.IsValid())
+				continue;
+			if (maxInteractors > 0 && interactors.Num() >= maxInteractors)
+				results[order[i]] = EInteractionArbitrationResult::Busy;
+			else
+			{
+				interactors.Add(request.Ability);
+				results[order[i]] = EInteractionArbitrationResult::Granted;
 			}
 		}
+	}
+
+	for (int32 i = 0; i < requests.Num(); ++i)
+		requests[i].OnArbitrated.ExecuteIfBound(results[i], results[i] == EInteractionArbitrationResult::NoTarget ? FInteractableHandle() : requests[i].Target);
+}
+
+TStatId UInteractionArbiterSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UInteractionArbiterSubsystem, STATGROUP_Tickables);
+}
+
+bool UInteractionArbiterSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+//------------------------------------------------------------------------------------------------------------/UInteractionHoldComponent/------------------------------------------------------------------------------------------------------------
+void FInteractionHolder::PreReplicatedRemove(const FInteractionHolders& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+		InArraySerializer.Owner->OnHoldersChanged.Broadcast(InstanceIndex);
+}
+
+void FInteractionHolder::PostReplicatedAdd(const FInteractionHolders& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+		InArraySerializer.Owner->OnHoldersChanged.Broadcast(InstanceIndex);
+}
+
+void FInteractionHolder::PostReplicatedChange(const FInteractionHolders& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+		InArraySerializer.Owner->OnHoldersChanged.Broadcast(InstanceIndex);
+}
+
+UInteractionHoldComponent::UInteractionHoldComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UInteractionHoldComponent::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// Properties copied from the archetype include the raw owner of the template
+	Holders.Owner = this;
+}
+
+void UInteractionHoldComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// Holders change only when someone starts or stops holding, progress itself is never replicated
+	FDoRepLifetimeParams params;
+	params.bIsPushBased = true;
+	DOREPLIFETIME_WITH_PARAMS_FAST(UInteractionHoldComponent, Holders, params);
+}
+
+void UInteractionHoldComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UWorld* world = GetWorld())
+		for (TPair<int32, FTimerHandle>& completionTimer : CompletionTimers)
+			world->GetTimerManager().ClearTimer(completionTimer.Value);
+	CompletionTimers.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UInteractionHoldComponent::AddHolder(AActor* Instigator, int32 InstanceIndex, float Duration, float Contribution, float TimeCredit)
+{
+	if (!GetOwner()->HasAuthority() || !IsValid(Instigator) || Duration <= 0.f)
+		return;
+
+	const float time = UGAInteraction::GetServerWorldTime(GetWorld());
+	Rebase(InstanceIndex, time);
+
+	float baseProgress = 0.f;
+	for (const FInteractionHolder& holder : Holders.Items)
+		if (holder.InstanceIndex == InstanceIndex)
+		{
+			if (holder.Instigator == Instigator)
+				return;
+			baseProgress = holder.BaseProgress;
+		}
+
+	// Time the instigator has already held is counted as its own contribution
+	FInteractionHolder& holder = Holders.Items.AddDefaulted_GetRef();
+	holder.Instigator = Instigator;
+	holder.InstanceIndex = InstanceIndex;
+	holder.StartTime = time - TimeCredit;
+	holder.Duration = Duration;
+	holder.Contribution = Contribution;
+	holder.BaseProgress = baseProgress + TimeCredit * Contribution / Duration;
+	holder.BaseTime = time;
+	Holders.MarkItemDirty(holder);
+	Rebase(InstanceIndex, time);
+	MarkHoldersDirty();
+
+	OnHoldersChanged.Broadcast(InstanceIndex);
+	ScheduleCompletion(InstanceIndex, time);
+}
+
+void UInteractionHoldComponent::RemoveHolder(AActor* Instigator, int32 InstanceIndex)
+{
+	if (!GetOwner()->HasAuthority())
+		return;
+
+	const float time = UGAInteraction::GetServerWorldTime(GetWorld());
+	Rebase(InstanceIndex, time);
+
+	const int32 numRemoved = Holders.Items.RemoveAll([Instigator, InstanceIndex](const FInteractionHolder& Holder) { return Holder.InstanceIndex == InstanceIndex && (Holder.Instigator == Instigator || Holder.Instigator.IsStale()); });
+	if (numRemoved == 0)
+		return;
+	Holders.MarkArrayDirty();
+	MarkHoldersDirty();
+
+	OnHoldersChanged.Broadcast(InstanceIndex);
+	ScheduleCompletion(InstanceIndex, time);
+}
+
+float UInteractionHoldComponent::GetHoldProgress(int32 InstanceIndex) const
+{
+	return GetHoldProgressAt(InstanceIndex, UGAInteraction::GetServerWorldTime(GetWorld()));
+}
+
+int32 UInteractionHoldComponent::GetNumHolders(int32 InstanceIndex) const
+{
+	int32 numHolders = 0;
+	for (const FInteractionHolder& holder : Holders.Items)
+		if (holder.InstanceIndex == InstanceIndex)
+			++numHolders;
+	return numHolders;
+}
+
+float UInteractionHoldComponent::GetHoldProgressAt(int32 InstanceIndex, float Time) const
+{
+	float rate = 0.f;
+	const FInteractionHolder* base = nullptr;
+	for (const FInteractionHolder& holder : Holders.Items)
+		if (holder.InstanceIndex == InstanceIndex)
+		{
+			rate += holder.Contribution / holder.Duration;
+			base = &holder;
+		}
+	if (!base)
+		return 0.f;
+	return FMath::Clamp(base->BaseProgress + FMath::Max(Time - base->BaseTime, 0.f) * rate, 0.f, 1.f);
+}
+
+float UInteractionHoldComponent::GetProgressRate(int32 InstanceIndex) const
+{
+	float rate = 0.f;
+	for (const FInteractionHolder& holder : Holders.Items)
+		if (holder.InstanceIndex == InstanceIndex)
+			rate += holder.Contribution / holder.Duration;
+	return rate;
+}
+
+void UInteractionHoldComponent::Rebase(int32 InstanceIndex, float Time)
+{
+	const float progress = GetHoldProgressAt(InstanceIndex, Time);
+	for (FInteractionHolder& holder : Holders.Items)
+		if (holder.InstanceIndex == InstanceIndex && (holder.BaseProgress != progress || holder.BaseTime != Time))
+		{
+			holder.BaseProgress = progress;
+			holder.BaseTime = Time;
+			Holders.MarkItemDirty(holder);
+		}
+}
+
+void UInteractionHoldComponent::ScheduleCompletion(int32 InstanceIndex, float Time)
+{
+	FTimerManager& timerManager = GetWorld()->GetTimerManager();
+	const float rate = GetProgressRate(InstanceIndex);
+	if (rate <= 0.f)
+	{
+		if (FTimerHandle* completionTimer = CompletionTimers.Find(InstanceIndex))
+			timerManager.ClearTimer(*completionTimer);
+		CompletionTimers.Remove(InstanceIndex);
+		return;
+	}
+
+	const float remainingTime = (1.f - GetHoldProgressAt(InstanceIndex, Time)) / rate;
+	if (remainingTime <= 0.f)
+	{
+		CompleteHold(InstanceIndex);
+		return;
+	}
+	timerManager.SetTimer(CompletionTimers.FindOrAdd(InstanceIndex), FTimerDelegate::CreateUObject(this, &UInteractionHoldComponent::CompleteHold, InstanceIndex), remainingTime, false);
+}
+
+void UInteractionHoldComponent::CompleteHold(int32 InstanceIndex)
+{
+	if (FTimerHandle* completionTimer = CompletionTimers.Find(InstanceIndex))
+		GetWorld()->GetTimerManager().ClearTimer(*completionTimer);
+	CompletionTimers.Remove(InstanceIndex);
+
+	// The earliest valid holder executes the interaction
+	AActor* executor = nullptr;
+	float executorStartTime = TNumericLimits<float>::Max();
+	for (const FInteractionHolder& holder : Holders.Items)
+		if (holder.InstanceIndex == InstanceIndex && holder.Instigator.IsValid() && holder.StartTime < executorStartTime)
+		{
+			executor = holder.Instigator.Get();
+			executorStartTime = holder.StartTime;
+		}
+
+	Holders.Items.RemoveAll([InstanceIndex](const FInteractionHolder& Holder) { return Holder.InstanceIndex == InstanceIndex; });
+	Holders.MarkArrayDirty();
+	MarkHoldersDirty();
+
+	OnHoldersChanged.Broadcast(InstanceIndex);
+	OnHoldCompleted.Broadcast(InstanceIndex, executor);
+}
+
+void UInteractionHoldComponent::MarkHoldersDirty()
+{
+	MARK_PROPERTY_DIRTY_FROM_NAME(UInteractionHoldComponent, Holders, this);
+}
+#if !UE_BUILD_SHIPPING
+//------------------------------------------------------------------------------------------------------------/Benchmark/------------------------------------------------------------------------------------------------------------
+// Results must be visible with default verbosity, LogInteractionSystem shows only warnings
+DEFINE_LOG_CATEGORY_STATIC(LogInteractionBenchmark, Display, All);
+
+/// <summary>
+/// Gives the benchmark access to the steps of the hold and outlining paths, which are private
+/// </summary>
+struct FInteractionBenchmarkAccess
+{
+	static bool IsHolding(const UGAInteraction* Ability)
+	{
+		return Ability->IsActive() && (Ability->HoldTimerHandle.IsValid() || Ability->bSharedHold);
+	}
+
+	static void RestartHold(UGAInteraction* Ability)
+	{
+		Ability->StopHolding();
+		Ability->HoldImplementanion(Ability->CurrentSpecHandle, Ability->CurrentActorInfo, Ability->CurrentActivationInfo, nullptr);
+	}
+
+	static void ValidateHoldTarget(UGAInteraction* Ability) { Ability->ValidateHoldTarget(); }
+	static void FinishHolding(UGAInteraction* Ability) { Ability->FinishHolding(); }
+
+	static void SetCueInstigator(AGC_InteractableOutlinig* Cue, AActor* Instigator) { Cue->CueInstigator = Instigator; }
+	static void TickCue(AGC_InteractableOutlinig* Cue, float DeltaTime) { Cue->Tick(DeltaTime); }
+	static void ApplyOutlines(UInteractionOutlineSubsystem* Outlines) { Outlines->ApplyOutlines(); }
+};
+
+namespace InteractionBenchmark
+{
+	struct FResult
+	{
+		FString Name;
+		int32 Calls = 0;
+		int32 PhysicsQueries = 0;
+		int64 MemoryDeltaBytes = 0;
+		double TotalSeconds = 0.0;
+		double P50Microseconds = 0.0;
+		double P90Microseconds = 0.0;
+		double P99Microseconds = 0.0;
+		double MaxMicroseconds = 0.0;
+	};
+
+	/// <summary>
+	/// Counters read before and after every case
+	/// </summary>
+	struct FCounters
+	{
+		uint64 LineOfSightTraces = 0;
+		uint64 UsedPhysical = 0;
+
+		static FCounters Now()
+		{
+			FCounters counters;
+			counters.LineOfSightTraces = InteractionStats::LineOfSightTraces;
+			counters.UsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+			return counters;
+		}
+	};
+
+	static FResult MakeResult(const FString& Name, TArray<double>& SampleSeconds, const FCounters& Start)
+	{
+		const FCounters end = FCounters::Now();
+		FResult result;
+		result.Name = Name;
+		result.Calls = SampleSeconds.Num();
+		result.PhysicsQueries = static_cast<int32>(end.LineOfSightTraces - Start.LineOfSightTraces);
+		result.MemoryDeltaBytes = static_cast<int64>(end.UsedPhysical) - static_cast<int64>(Start.UsedPhysical);
+		if (SampleSeconds.IsEmpty())
+			return result;
+
+		SampleSeconds.Sort();
+		auto percentile = [&SampleSeconds](double Percent)
+			{
+				return SampleSeconds[FMath::Min(SampleSeconds.Num() - 1, FMath::FloorToInt32(Percent * SampleSeconds.Num()))] * 1e6;
+			};
+		for (const double sample : SampleSeconds)
+			result.TotalSeconds += sample;
+		result.P50Microseconds = percentile(0.5);
+		result.P90Microseconds = percentile(0.9);
+		result.P99Microseconds = percentile(0.99);
+		result.MaxMicroseconds = SampleSeconds.Last() * 1e6;
+		return result;
+	}
+
+	static double MeasureSeconds(TFunctionRef<void()> Function)
+	{
+		const uint64 startCycles = FPlatformTime::Cycles64();
+		Function();
+		return (FPlatformTime::Cycles64() - startCycles) * FPlatformTime::GetSecondsPerCycle64();
+	}
+
+	static void WriteResults(const TArray<FResult>& Results, int32 NumInteractables, int32 NumAvatars)
+	{
+		const FString timestamp = FDateTime::Now().ToString();
+		const FString directory = FPaths::ProfilingDir() / TEXT("Interaction");
+
+		FString csv = TEXT("Benchmark,Interactables,Avatars,Calls,P50us,P90us,P99us,MaxUs,CallsPerSecond,PhysicsQueriesPerSecond,MemoryDeltaKB\n");
+		FString json = FString::Printf(TEXT("{\n\t\"Interactables\": %d,\n\t\"Avatars\": %d,\n\t\"Results\": [\n"), NumInteractables, NumAvatars);
+		for (int32 i = 0; i < Results.Num(); ++i)
+		{
+			const FResult& result = Results[i];
+			const double callsPerSecond = result.TotalSeconds > 0.0 ? result.Calls / result.TotalSeconds : 0.0;
+			const double queriesPerSecond = result.TotalSeconds > 0.0 ? result.PhysicsQueries / result.TotalSeconds : 0.0;
+			const double memoryDeltaKB = result.MemoryDeltaBytes / 1024.0;
+
+			UE_LOG(LogInteractionBenchmark, Display, TEXT("Interaction.Benchmark: %s calls=%d p50=%.2fus p90=%.2fus p99=%.2fus max=%.2fus calls/s=%.0f physics queries/s=%.0f memory delta=%.1fKB"),
+				*result.Name, result.Calls, result.P50Microseconds, result.P90Microseconds, result.P99Microseconds, result.MaxMicroseconds, callsPerSecond, queriesPerSecond, memoryDeltaKB);
+
+			csv += FString::Printf(TEXT("%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f\n"),
+				*result.Name, NumInteractables, NumAvatars, result.Calls, result.P50Microseconds, result.P90Microseconds, result.P99Microseconds, result.MaxMicroseconds, callsPerSecond, queriesPerSecond, memoryDeltaKB);
+			json += FString::Printf(TEXT("\t\t{ \"Name\": \"%s\", \"Calls\": %d, \"P50us\": %.3f, \"P90us\": %.3f, \"P99us\": %.3f, \"MaxUs\": %.3f, \"CallsPerSecond\": %.1f, \"PhysicsQueriesPerSecond\": %.1f, \"MemoryDeltaKB\": %.1f }%s\n"),
+				*result.Name, result.Calls, result.P50Microseconds, result.P90Microseconds, result.P99Microseconds, result.MaxMicroseconds, callsPerSecond, queriesPerSecond, memoryDeltaKB, i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+		}
+		json += TEXT("\t]\n}\n");
+
+		const FString csvPath = directory / FString::Printf(TEXT("InteractionBenchmark-%s.csv"), *timestamp);
+		const FString jsonPath = directory / FString::Printf(TEXT("InteractionBenchmark-%s.json"), *timestamp);
+		if (FFileHelper::SaveStringToFile(csv, *csvPath) && FFileHelper::SaveStringToFile(json, *jsonPath))
+			UE_LOG(LogInteractionBenchmark, Display, TEXT("Interaction.Benchmark: Results are written to %s"), *directory);
 		else
+			UE_LOG(LogInteractionBenchmark, Error, TEXT("Interaction.Benchmark: Failed to write results to %s"), *directory);
+	}
+
+	/// <summary>
+	/// Runs all cases in the world. Arguments are parsed from the string, e.g. "Interactables=10000 Avatars=200 Class=/Game/Path/BP_Interactable.BP_Interactable_C".
+	/// </summary>
+	/// <returns>False if the benchmark can't run in the world</returns>
+	static bool Run(const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World || !World->IsGameWorld())
+		{
+			UE_LOG(LogInteractionBenchmark, Error, TEXT("Interaction.Benchmark: Must be run in a game world"));
+			return false;
+		}
+		UInteractableRegistrySubsystem* registry = World->GetSubsystem<UInteractableRegistrySubsystem>();
+		UInteractionTargetingSubsystem* targeting = World->GetSubsystem<UInteractionTargetingSubsystem>();
+		UInteractionOutlineSubsystem* outlines = World->GetSubsystem<UInteractionOutlineSubsystem>();
+		UInteractionArbiterSubsystem* arbiter = World->GetSubsystem<UInteractionArbiterSubsystem>();
+		if (!registry || !targeting || !outlines)
+			return false;
+
+		const FString commandLine = FString::Join(Args, TEXT(" "));
+		int32 numInteractables = 0;
+		int32 numAvatars = 16;
+		int32 iterations = 100;
+		FString interactableClassPath;
+		FParse::Value(*commandLine, TEXT("Interactables="), numInteractables);
+		FParse::Value(*commandLine, TEXT("Avatars="), numAvatars);
+		FParse::Value(*commandLine, TEXT("Iterations="), iterations);
+		FParse::Value(*commandLine, TEXT("Class="), interactableClassPath);
+
+		UClass* interactableClass = interactableClassPath.IsEmpty() ? nullptr : LoadClass<AActor>(nullptr, *interactableClassPath);
+		if (numInteractables > 0 && (!interactableClass || !interactableClass->ImplementsInterface(UInteractable::StaticClass())))
+		{
+			UE_LOG(LogInteractionBenchmark, Error, TEXT("Interaction.Benchmark: Class=%s isn't an actor class implementing IInteractable"), *interactableClassPath);
+			return false;
+		}
+
+		// Fixed seed keeps the scene the same from build to build
+		FRandomStream random(12345);
+		const float areaExtent = FMath::Max(1000.f, FMath::Sqrt(static_cast<float>(numInteractables)) * 200.f);
+		auto randomLocation = [&random, areaExtent]()
+			{
+				return FVector(random.FRandRange(-areaExtent, areaExtent), random.FRandRange(-areaExtent, areaExtent), random.FRandRange(0.f, 200.f));
+			};
+
+		FActorSpawnParameters spawnParameters;
+		spawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		TArray<AActor*> interactables;
+		for (int32 i = 0; i < numInteractables; ++i)
+			if (AActor* interactable = World->SpawnActor<AActor>(interactableClass, FTransform(randomLocation()), spawnParameters))
+				interactables.Add(interactable);
+
+		// Avatars have a camera, an ability system with the interaction ability and an outlining cue, like players
+		const bool bAuthority = World->GetNetMode() != NM_Client;
+		TArray<AActor*> avatars;
+		TArray<FGameplayAbilitySpecHandle> abilityHandles;
+		TArray<AGC_InteractableOutlinig*> cues;
+		for (int32 i = 0; i < numAvatars; ++i)
+		{
+			AActor* avatar = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, spawnParameters);
+			UCameraComponent* camera = NewObject<UCameraComponent>(avatar);
+			avatar->SetRootComponent(camera);
+			avatar->AddInstanceComponent(camera);
+			camera->RegisterComponent();
+			avatar->SetActorLocationAndRotation(randomLocation() + FVector(0.f, 0.f, 150.f), FRotator(random.FRandRange(-30.f, 0.f), random.FRandRange(0.f, 360.f), 0.f));
+			avatars.Add(avatar);
+
+			if (bAuthority)
+			{
+				UAbilitySystemComponent* asc = NewObject<UAbilitySystemComponent>(avatar);
+				avatar->AddInstanceComponent(asc);
+				asc->RegisterComponent();
+				asc->InitAbilityActorInfo(avatar, avatar);
+				abilityHandles.Add(asc->GiveAbility(FGameplayAbilitySpec(UGAInteraction::StaticClass())));
+			}
+
+			AGC_InteractableOutlinig* cue = World->SpawnActor<AGC_InteractableOutlinig>(AGC_InteractableOutlinig::StaticClass(), FTransform::Identity, spawnParameters);
+			FInteractionBenchmarkAccess::SetCueInstigator(cue, avatar);
+			cues.Add(cue);
+		}
+
+		TArray<FResult> results;
+		TArray<double> samples;
+		samples.Reserve(iterations * numAvatars * 3);
+
+		// Raw query: from none to MaxLineOfSightChecks line traces per call, the traces actually made are counted
+		FCounters start = FCounters::Now();
+		for (int32 i = 0; i < iterations; ++i)
+			for (const AActor* avatar : avatars)
+				samples.Add(MeasureSeconds([avatar]() { UGAInteraction::GetInteractionTarget(avatar); }));
+		results.Add(MakeResult(TEXT("GetInteractionTarget"), samples, start));
+		samples.Reset();
+
+		// Three consumers per avatar per frame (outlining, hold re-validation, activation) served by the cache
+		start = FCounters::Now();
+		for (int32 i = 0; i < iterations; ++i)
+			for (const AActor* avatar : avatars)
+			{
+				targeting->InvalidateTarget(avatar);
+				samples.Add(MeasureSeconds([avatar]()
+					{
+						for (int32 consumer = 0; consumer < 3; ++consumer)
+							UGAInteraction::GetCachedInteractionTarget(avatar);
+					}));
+			}
+		results.Add(MakeResult(TEXT("GetCachedInteractionTarget x3"), samples, start));
+		samples.Reset();
+
+		// Outlining: tick of every cue (adaptive query gate, target query, outline requests) while the cameras turn, then the end of frame diff of outlines
+		TArray<double> applySamples;
+		start = FCounters::Now();
+		for (int32 i = 0; i < iterations; ++i)
+		{
+			for (int32 avatarIndex = 0; avatarIndex < avatars.Num(); ++avatarIndex)
+			{
+				avatars[avatarIndex]->AddActorLocalRotation(FRotator(0.f, 3.f, 0.f));
+				AGC_InteractableOutlinig* cue = cues[avatarIndex];
+				samples.Add(MeasureSeconds([cue]() { FInteractionBenchmarkAccess::TickCue(cue, 1.f / 60.f); }));
+			}
+			applySamples.Add(MeasureSeconds([outlines]() { FInteractionBenchmarkAccess::ApplyOutlines(outlines); }));
+		}
+		results.Add(MakeResult(TEXT("Outlining tick"), samples, start));
+		results.Add(MakeResult(TEXT("ApplyOutlines"), applySamples, start));
+		samples.Reset();
+
+		// Hold: activation goes through the arbiter, then every step of the hold is timed on the abilities which hold their target
+		if (bAuthority && arbiter)
+		{
+			TArray<UGAInteraction*> holdingAbilities;
+			start = FCounters::Now();
+			for (int32 avatarIndex = 0; avatarIndex < abilityHandles.Num(); ++avatarIndex)
+			{
+				UAbilitySystemComponent* asc = avatars[avatarIndex]->FindComponentByClass<UAbilitySystemComponent>();
+				FGameplayAbilitySpec* spec = asc->FindAbilitySpecFromHandle(abilityHandles[avatarIndex]);
+				// Hold waits for the input release, which must not come during the benchmark
+				spec->InputPressed = true;
+				asc->TryActivateAbility(abilityHandles[avatarIndex]);
+			}
+			samples.Add(MeasureSeconds([arbiter]() { arbiter->Tick(0.f); }));
+			results.Add(MakeResult(TEXT("Arbitration"), samples, start));
+			samples.Reset();
+
+			for (int32 avatarIndex = 0; avatarIndex < abilityHandles.Num(); ++avatarIndex)
+			{
+				UAbilitySystemComponent* asc = avatars[avatarIndex]->FindComponentByClass<UAbilitySystemComponent>();
+				if (FGameplayAbilitySpec* spec = asc->FindAbilitySpecFromHandle(abilityHandles[avatarIndex]))
+					if (UGAInteraction* ability = Cast<UGAInteraction>(spec->GetPrimaryInstance()))
+						if (FInteractionBenchmarkAccess::IsHolding(ability))
+							holdingAbilities.Add(ability);
+			}
+
+			if (holdingAbilities.IsEmpty())
+				UE_LOG(LogInteractionBenchmark, Warning, TEXT("Interaction.Benchmark: No avatar holds a target, hold cases are skipped. Class must be a Hold interactable with positive hold duration."));
+			else
+			{
+				TArray<double> validateSamples;
+				start = FCounters::Now();
+				for (int32 i = 0; i < iterations; ++i)
+					for (UGAInteraction* ability : holdingAbilities)
+					{
+						samples.Add(MeasureSeconds([ability]() { FInteractionBenchmarkAccess::RestartHold(ability); }));
+						validateSamples.Add(MeasureSeconds([ability]() { FInteractionBenchmarkAccess::ValidateHoldTarget(ability); }));
+					}
+				results.Add(MakeResult(TEXT("HoldImplementanion"), samples, start));
+				results.Add(MakeResult(TEXT("ValidateHoldTarget"), validateSamples, start));
+				samples.Reset();
+
+				// Completion ends the ability, so it is measured once per avatar
+				start = FCounters::Now();
+				for (UGAInteraction* ability : holdingAbilities)
+					if (FInteractionBenchmarkAccess::IsHolding(ability))
+						samples.Add(MeasureSeconds([ability]() { FInteractionBenchmarkAccess::FinishHolding(ability); }));
+				results.Add(MakeResult(TEXT("FinishHolding"), samples, start));
+				samples.Reset();
+			}
+		}
+
+		// Registry maintenance for moving interactables. The move updates the registry through TransformUpdated, so the move itself is timed.
+		start = FCounters::Now();
+		for (int32 i = 0; i < iterations && interactables.Num() > 0; ++i)
+			for (AActor* interactable : interactables)
+				if (USceneComponent* root = interactable->GetRootComponent())
+					samples.Add(MeasureSeconds([root]() { root->SetWorldLocation(root->GetComponentLocation() + FVector(1.f, 0.f, 0.f)); }));
+		results.Add(MakeResult(TEXT("MoveInteractable"), samples, start));
+
+		WriteResults(results, registry->GetNumInteractables(), avatars.Num());
+
+		for (AActor* actor : cues)
+			actor->Destroy();
+		for (AActor* actor : interactables)
+			actor->Destroy();
+		for (AActor* actor : avatars)
+			actor->Destroy();
+		return true;
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchmarkCommand(
+		TEXT("Interaction.Benchmark"),
+		TEXT("Measures interaction targeting, outlining and holds and writes CSV and JSON to Saved/Profiling/Interaction. Usage: Interaction.Benchmark [Interactables=0] [Avatars=16] [Iterations=100] [Class=/Game/Path/BP_Interactable.BP_Interactable_C]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) { Run(Args, World); }));
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FInteractionBenchmarkTest, "InteractionSystem.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FInteractionBenchmarkTest::RunTest(const FString& Parameters)
+{
+	// Scene is taken from the command line, e.g. -ExecCmds="Automation RunTests InteractionSystem.Benchmark" Interactables=10000 Avatars=200 Class=/Game/Path/BP_Interactable.BP_Interactable_C
+	UWorld* world = nullptr;
+	for (const FWorldContext& context : GEngine->GetWorldContexts())
+		if ((context.WorldType == EWorldType::Game || context.WorldType == EWorldType::PIE) && context.World())
 		{
-			UE_LOG(LogInteractionSystem, Error, TEXT("UInteractionLocalPlayerSubsystem: Player's Pawn does not have a CameraComponent."));
+			world = context.World();
+			break;
 		}
+	if (!world)
+	{
+		AddError(TEXT("InteractionSystem.Benchmark needs a game world, run it with a map loaded"));
+		return false;
 	}
+	return InteractionBenchmark::Run({ FString(FCommandLine::Get()) }, world);
 }
+#endif
+#endif
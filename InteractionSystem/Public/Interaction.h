@@ -8,9 +8,69 @@
 #include "UObject/Interface.h"
 #include "AbilitySystemComponent.h"
 #include "Abilities/GameplayAbility.h"
+#include "Abilities/GameplayAbilityTargetTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/StreamableManager.h"
+#include "Net/Serialization/FastArraySerializer.h"
 #include "Interaction.generated.h"
 
+class UCameraComponent;
+class UGAInteraction;
+class UInteractableInstancedStaticMeshComponent;
+class UInteractableRegistrySubsystem;
+class UInteractionHoldComponent;
+class UAbilityTask_WaitInputRelease;
+struct FTraceDatum;
+
 DECLARE_LOG_CATEGORY_EXTERN(LogInteractionSystem, Warning, All)
+DECLARE_STATS_GROUP(TEXT("Interaction"), STATGROUP_Interaction, STATCAT_Advanced);
+//------------------------------------------------------------------------------------------------------------/FInteractableHandle/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Identifies an interaction target: an actor implementing IInteractable, or one instance of its UInteractableInstancedStaticMeshComponent.
+/// Instances let thousands of pickups be interactable without an actor for each of them.
+/// </summary>
+USTRUCT(BlueprintType)
+struct INTERACTIONSYSTEM_API FInteractableHandle
+{
+	GENERATED_BODY()
+
+	FInteractableHandle() {}
+	// Handle is only a key, the actor is never modified through it
+	FInteractableHandle(const AActor* InActor, int32 InInstanceIndex = INDEX_NONE) : Actor(const_cast<AActor*>(InActor)), InstanceIndex(InInstanceIndex) {}
+
+	/// <summary>
+	/// Interactable actor or owner of the instances
+	/// </summary>
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	TWeakObjectPtr<AActor> Actor;
+	/// <summary>
+	/// Index of the instance in UInteractableInstancedStaticMeshComponent of the actor, INDEX_NONE for the actor itself
+	/// </summary>
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	int32 InstanceIndex = INDEX_NONE;
+
+	AActor* GetActor() const { return Actor.Get(); }
+	bool IsInstance() const { return InstanceIndex != INDEX_NONE; }
+	bool IsValid() const { return Actor.IsValid(); }
+
+	// Weak pointers are compared by identity, == of TWeakObjectPtr treats a destroyed actor as equal to an empty handle
+	bool operator==(const FInteractableHandle& Other) const { return Actor.HasSameIndexAndSerialNumber(Other.Actor) && InstanceIndex == Other.InstanceIndex; }
+	bool operator!=(const FInteractableHandle& Other) const { return !(*this == Other); }
+	friend uint32 GetTypeHash(const FInteractableHandle& Handle) { return HashCombine(GetTypeHash(Handle.Actor), ::GetTypeHash(Handle.InstanceIndex)); }
+};
+
+DECLARE_DELEGATE_OneParam(FOnInteractionTargetResolved, const FInteractableHandle& /*Target*/);
+
+UENUM(BlueprintType)
+enum class EInteractionArbitrationResult : uint8 {
+	Granted = 0 UMETA(DisplayName = "Granted"),
+	NoTarget = 1 UMETA(DisplayName = "No target"),
+	Busy = 2 UMETA(DisplayName = "Busy"),
+	RateLimited = 3 UMETA(DisplayName = "Rate limited")
+};
+
+DECLARE_DELEGATE_TwoParams(FOnInteractionArbitrated, EInteractionArbitrationResult /*Result*/, const FInteractableHandle& /*Target*/);
 
 UENUM(BlueprintType)                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                 
 enum class EInteractionType : uint8 {
@@ -33,6 +93,13 @@ class IInteractable
 public:
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
 	bool Interact(AActor* Instigator);
+	/// <summary>
+	/// Called on server instead of Interact when the target is an instance of UInteractableInstancedStaticMeshComponent of this actor.
+	/// </summary>
+	/// <param name="Instigator"></param>
+	/// <param name="InstanceIndex"></param>
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
+	bool InteractWithInstance(AActor* Instigator, int32 InstanceIndex);
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
 	EInteractionType GetInteractionType() const;
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
@@ -43,16 +110,847 @@ public:
 	USceneComponent* GetTooltipPlace() const;
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
 	FText GetTooltipText() const;
+	/// <summary>
+	/// How many instigators can interact with the object at the same time. 0 - any number, 1 - exclusive.
+	/// Checked by UInteractionArbiterSubsystem on server.
+	/// </summary>
+	/// <returns></returns>
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
+	int32 GetMaxConcurrentInteractors() const;
+	/// <summary>
+	/// Called only on the predicting client right after it has interacted locally. Use it for cosmetic feedback, the real result comes from Interact on server.
+	/// </summary>
+	/// <param name="Instigator"></param>
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
+	void PredictInteract(AActor* Instigator);
+	/// <summary>
+	/// Called on the predicting client when the server has rejected the predicted interaction. Must revert what PredictInteract did.
+	/// </summary>
+	/// <param name="Instigator"></param>
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = Interaction)
+	void RollbackPredictedInteract(AActor* Instigator);
+
+	virtual void PredictInteract_Implementation(AActor* Instigator) {}
+	virtual void RollbackPredictedInteract_Implementation(AActor* Instigator) {}
+	virtual int32 GetMaxConcurrentInteractors_Implementation() const { return 0; }
+	virtual bool InteractWithInstance_Implementation(AActor* Instigator, int32 InstanceIndex) { return false; }
+};
+//------------------------------------------------------------------------------------------------------------/FGameplayAbilityTargetData_Interaction/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Target data sent by the predicting client to the server with the interaction target it has chosen.
+/// </summary>
+USTRUCT()
+struct INTERACTIONSYSTEM_API FGameplayAbilityTargetData_Interaction : public FGameplayAbilityTargetData
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TWeakObjectPtr<AActor> Target;
+	UPROPERTY()
+	int32 InstanceIndex = INDEX_NONE;
+	/// <summary>
+	/// Server world time when the client has started the interaction
+	/// </summary>
+	UPROPERTY()
+	float ClientTimestamp = 0.f;
+
+	virtual TArray<TWeakObjectPtr<AActor>> GetActors() const override { return { Target }; }
+	virtual UScriptStruct* GetScriptStruct() const override { return FGameplayAbilityTargetData_Interaction::StaticStruct(); }
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+	{
+		Ar << Target;
+		Ar << InstanceIndex;
+		Ar << ClientTimestamp;
+		bOutSuccess = true;
+		return true;
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FGameplayAbilityTargetData_Interaction> : public TStructOpsTypeTraitsBase2<FGameplayAbilityTargetData_Interaction>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+//------------------------------------------------------------------------------------------------------------/FInteractionTargetingParams/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Describes how the interaction target is chosen. Candidates are interactables whose bounds are inside the view cone widened by CandidateRadius and not farther than MaxDistance.
+/// The candidate with the best score wins: the score falls with the angle to the view direction and with the distance.
+/// </summary>
+USTRUCT(BlueprintType)
+struct INTERACTIONSYSTEM_API FInteractionTargetingParams
+{
+	GENERATED_BODY()
+
+	/// <summary>
+	/// Distance from the camera to the closest point of the target bounds along the view direction
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Interaction, meta = (ClampMin = "1"))
+	float MaxDistance = 500.f;
+	/// <summary>
+	/// Distance by which the view cone is widened. Keeps small and thin interactables easy to aim at.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Interaction, meta = (ClampMin = "0"))
+	float CandidateRadius = 50.f;
+	/// <summary>
+	/// Half angle of the view cone in degrees
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Interaction, meta = (ClampMin = "0", ClampMax = "89"))
+	float MaxAngleDegrees = 10.f;
+	/// <summary>
+	/// Weight of the distance from the view axis relative to the cone border
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Interaction, meta = (ClampMin = "0"))
+	float AngleWeight = 1.f;
+	/// <summary>
+	/// Weight of the distance from the camera relative to MaxDistance
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Interaction, meta = (ClampMin = "0"))
+	float DistanceWeight = 0.5f;
+	/// <summary>
+	/// Rejects candidates whose bounds center is hidden from the camera behind other geometry
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Interaction)
+	bool bRequireLineOfSight = true;
+	/// <summary>
+	/// How many of the best candidates are tested for line of sight before the query gives up
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Interaction, meta = (ClampMin = "1", EditCondition = "bRequireLineOfSight"))
+	int32 MaxLineOfSightChecks = 3;
+
+	/// <summary>
+	/// Returns the box which contains the widened view cone
+	/// </summary>
+	FBox GetQueryBox(const FVector& Origin, const FVector& Direction) const;
+
+	bool operator==(const FInteractionTargetingParams& Other) const;
+	bool operator!=(const FInteractionTargetingParams& Other) const { return !(*this == Other); }
+};
+
+/// <summary>
+/// Structure of arrays of interactables around the view, filled by UInteractableRegistrySubsystem and scored by UGAInteraction::ScoreInteractionCandidates.
+/// Locations are bounds centers relative to Origin, Radius is the radius of the bounding sphere. After Pad() arrays have a multiple of 4 elements.
+/// </summary>
+struct INTERACTIONSYSTEM_API FInteractionCandidates
+{
+	FVector Origin = FVector::ZeroVector;
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+	TArray<float> Radius;
+	TArray<FInteractableHandle> Handles;
+	// Number of real candidates, without padding
+	int32 Num = 0;
+
+	void Reset(const FVector& InOrigin);
+	void Add(const FInteractableHandle& Handle, const FBox& Bounds);
+	void Pad();
+};
+
+struct FInteractionCandidate
+{
+	FInteractableHandle Handle;
+	FVector Location = FVector::ZeroVector;
+};
+typedef TArray<FInteractionCandidate, TInlineAllocator<4>> FRankedInteractionCandidates;
+//------------------------------------------------------------------------------------------------------------/FInteractableDescriptor/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Snapshot of the IInteractable data used on hot paths. Built by UInteractableRegistrySubsystem on first use and rebuilt only after InvalidateDescriptor,
+/// so targeting, outlining and the interaction ability don't go through interface calls every time.
+/// </summary>
+USTRUCT()
+struct INTERACTIONSYSTEM_API FInteractableDescriptor
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<TWeakObjectPtr<UMeshComponent>> Meshes;
+	UPROPERTY()
+	TWeakObjectPtr<USceneComponent> TooltipPlace;
+	UPROPERTY()
+	FText TooltipText;
+	UPROPERTY()
+	float HoldDuration = 0.f;
+	UPROPERTY()
+	EInteractionType Type = EInteractionType::Press;
+	UPROPERTY()
+	int32 MaxConcurrentInteractors = 0;
+	/// <summary>
+	/// Set only for instances, which are outlined through per-instance custom data instead of Meshes
+	/// </summary>
+	UPROPERTY()
+	TWeakObjectPtr<UInteractableInstancedStaticMeshComponent> InstancedMesh;
+	UPROPERTY()
+	int32 InstanceIndex = INDEX_NONE;
+
+	/// <summary>
+	/// Collects the data from IInteractable of the actor
+	/// </summary>
+	static FInteractableDescriptor Build(const AActor* Actor);
+	/// <summary>
+	/// Collects the data of one instance
+	/// </summary>
+	static FInteractableDescriptor BuildForInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex);
+};
+//------------------------------------------------------------------------------------------------------------/UInteractableInstancedStaticMeshComponent/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Interaction data of one instance
+/// </summary>
+USTRUCT(BlueprintType)
+struct INTERACTIONSYSTEM_API FInteractableInstanceData
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Interaction)
+	EInteractionType Type = EInteractionType::Press;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Interaction)
+	float HoldDuration = 0.f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Interaction)
+	FText TooltipText;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Interaction)
+	int32 MaxConcurrentInteractors = 0;
+	/// <summary>
+	/// Disabled instances are hidden and can't be targeted
+	/// </summary>
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Interaction)
+	bool bEnabled = true;
+};
+
+/// <summary>
+/// Instanced meshes whose instances are separate interaction targets, e.g. foliage pickups, ore nodes or loot. The owner must implement IInteractable,
+/// interaction with an instance calls IInteractable::InteractWithInstance. An actor can have only one such component, and the actor itself is not a target then.
+/// Instances must not be removed with RemoveInstance, it would change indices of the rest. Disable them with SetInstanceEnabled instead.
+/// </summary>
+UCLASS(ClassGroup = Interaction, meta = (BlueprintSpawnableComponent))
+class INTERACTIONSYSTEM_API UInteractableInstancedStaticMeshComponent : public UHierarchicalInstancedStaticMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	/// <summary>
+	/// Adds an instance and registers it in the registry. Returns its index.
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	int32 AddInteractableInstance(const FTransform& InstanceTransform, const FInteractableInstanceData& Data, bool bWorldSpace = false);
+	/// <summary>
+	/// Enabled instance is visible and can be targeted. Disabled instance is hidden by zero scale and unregistered, its index stays reserved.
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void SetInstanceEnabled(int32 InstanceIndex, bool bEnabled);
+	/// <summary>
+	/// Replaces the interaction data of the instance
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void SetInstanceData(int32 InstanceIndex, const FInteractableInstanceData& Data);
+	/// <summary>
+	/// Moves the instance and updates it in the registry
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void SetInteractableInstanceTransform(int32 InstanceIndex, const FTransform& InstanceTransform, bool bWorldSpace = false);
+
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	FInteractableInstanceData GetInstanceData(int32 InstanceIndex) const;
+	bool IsInstanceEnabled(int32 InstanceIndex) const;
+	/// <summary>
+	/// World bounds of the instance
+	/// </summary>
+	FBox GetInstanceBounds(int32 InstanceIndex) const;
+	/// <summary>
+	/// Writes the outline stencil value to per-instance custom data, read by the material of the mesh. 0 removes the outline.
+	/// </summary>
+	void SetInstanceOutlineStencil(int32 InstanceIndex, int32 StencilValue);
+
+protected:
+	virtual void BeginPlay() override;
+
+	/// <summary>
+	/// Data of instances placed in the editor. Instances without data use DefaultInstanceData.
+	/// </summary>
+	UPROPERTY(EditAnywhere, Category = Interaction)
+	TArray<FInteractableInstanceData> InstanceData;
+	UPROPERTY(EditAnywhere, Category = Interaction)
+	FInteractableInstanceData DefaultInstanceData;
+	/// <summary>
+	/// Index of the per-instance custom data float which holds the outline stencil value of the instance. NumCustomDataFloats must be greater.
+	/// </summary>
+	UPROPERTY(EditAnywhere, Category = Interaction, meta = (ClampMin = "0"))
+	int32 OutlineCustomDataIndex = 0;
+
+private:
+	// Scale of disabled instances before they have been hidden
+	TMap<int32, FVector> HiddenInstanceScales;
+
+	FInteractableInstanceData& GetMutableInstanceData(int32 InstanceIndex);
+	UInteractableRegistrySubsystem* GetRegistry() const;
+};
+//------------------------------------------------------------------------------------------------------------/UInteractableRegistrySubsystem/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Spatial registry of interactable actors. Interactables are bucketed into a uniform grid and moved between cells when their root component moves,
+/// so target lookup only visits interactables near the trace point instead of every primitive overlapping it.
+/// Actors implementing IInteractable are registered automatically when the world begins play, when they are spawned and when their level is streamed in.
+/// </summary>
+UCLASS(config = Game)
+class INTERACTIONSYSTEM_API UInteractableRegistrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	/// <summary>
+	/// Adds the actor to the registry. Does nothing if the actor doesn't implement IInteractable or is already registered.
+	/// </summary>
+	/// <param name="Actor"></param>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void RegisterInteractable(AActor* Actor);
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void UnregisterInteractable(AActor* Actor);
+	/// <summary>
+	/// Recomputes bounds of the actor and moves it between cells if needed. Called automatically when the root component moves.
+	/// </summary>
+	/// <param name="Actor"></param>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void UpdateInteractable(AActor* Actor);
+
+	/// <summary>
+	/// Adds an instance of the component to the registry. Called by the component, and for every enabled instance when its owner is registered.
+	/// </summary>
+	void RegisterInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex);
+	void UnregisterInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex);
+	/// <summary>
+	/// Recomputes bounds of the instance and drops its cached descriptor
+	/// </summary>
+	void UpdateInstance(UInteractableInstancedStaticMeshComponent* Component, int32 InstanceIndex);
+
+	/// <summary>
+	/// Wakes a dormant interactable on server while an interaction with it is in progress. Every call must be paired with EndNetInteraction.
+	/// Does nothing for interactables whose dormancy isn't managed.
+	/// </summary>
+	/// <param name="Actor"></param>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void BeginNetInteraction(AActor* Actor);
+	/// <summary>
+	/// Interactable becomes dormant again after DormancyQuietPeriod without interactions
+	/// </summary>
+	/// <param name="Actor"></param>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void EndNetInteraction(AActor* Actor);
+
+	/// <summary>
+	/// Appends every registered interactable whose bounds intersect the box to OutCandidates.
+	/// </summary>
+	/// <param name="Box"></param>
+	/// <param name="IgnoredActor">Actor which is never added, usually the avatar performing the query. Can be nullptr.</param>
+	/// <param name="OutCandidates"></param>
+	/// <param name="RewindTime">Server world time for which moving interactables are taken from their history. Clamped to MaxRewindTime.</param>
+	void GatherCandidates(const FBox& Box, const AActor* IgnoredActor, FInteractionCandidates& OutCandidates, TOptional<float> RewindTime = TOptional<float>()) const;
+	/// <summary>
+	/// Returns bounds of a registered interactable at the server world time, taken from its history if it has moved. Time is clamped to MaxRewindTime.
+	/// Returns false if the actor isn't registered.
+	/// </summary>
+	bool GetBoundsAtTime(const FInteractableHandle& Handle, float Time, FBox& OutBounds) const;
+
+	/// <summary>
+	/// Returns the cached descriptor of a registered interactable, rebuilding it if it was invalidated. Returns nullptr if the target isn't registered.
+	/// Pointer is valid until the registry changes, don't store it across frames.
+	/// </summary>
+	/// <param name="Handle"></param>
+	/// <returns></returns>
+	const FInteractableDescriptor* GetDescriptor(const FInteractableHandle& Handle);
+	/// <summary>
+	/// Must be called when data returned by IInteractable of the actor has changed, e.g. hold duration or meshes for outlining.
+	/// </summary>
+	/// <param name="Actor"></param>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void InvalidateDescriptor(AActor* Actor);
+	/// <summary>
+	/// Returns the descriptor from the registry of the actor`s world. Returns nullptr if the target isn't registered.
+	/// </summary>
+	/// <param name="Handle"></param>
+	/// <returns></returns>
+	static const FInteractableDescriptor* FindDescriptor(const FInteractableHandle& Handle);
+
+	/// <summary>
+	/// Returns a number which changes whenever an interactable inside the box is added, removed or moved. Uses cell granularity.
+	/// </summary>
+	/// <param name="Box"></param>
+	/// <returns></returns>
+	uint64 GetRevisionInBox(const FBox& Box) const;
+
+	int32 GetNumInteractables() const { return Entries.Num(); }
+	/// <summary>
+	/// Returns how many moving interactables have a transform history now
+	/// </summary>
+	int32 GetNumTrackedInteractables() const { return Histories.Num(); }
+	/// <summary>
+	/// Returns how many interactables with managed dormancy are dormant now
+	/// </summary>
+	int32 GetNumDormantInteractables() const { return DormancyStates.Num() - NumAwakeInteractables; }
+	int32 GetNumAwakeInteractables() const { return NumAwakeInteractables; }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/// <summary>
+	/// Edge length of a grid cell. Should be around the usual interaction distance.
+	/// </summary>
+	UPROPERTY(Config)
+	float CellSize = 500.f;
+
+	//-----Lag compensation------
+	/// <summary>
+	/// How many samples per second are recorded to the history of a moving interactable on server. 0 disables the history.
+	/// </summary>
+	UPROPERTY(Config)
+	float HistorySampleRate = 20.f;
+	/// <summary>
+	/// Number of samples in the history of one interactable. HistoryCapacity / HistorySampleRate should be longer than MaxRewindTime.
+	/// </summary>
+	UPROPERTY(Config)
+	int32 HistoryCapacity = 16;
+	/// <summary>
+	/// Upper limit of interactables with a history. Interactables above it are validated at their present location.
+	/// </summary>
+	UPROPERTY(Config)
+	int32 MaxTrackedInteractables = 1024;
+	/// <summary>
+	/// How far back in seconds a query can be rewound
+	/// </summary>
+	UPROPERTY(Config)
+	float MaxRewindTime = 0.5f;
+
+	//-----Net dormancy------
+	/// <summary>
+	/// Replicated interactables with NetDormancy DORM_Initial or DORM_DormantAll are kept dormant on server and woken only while someone interacts with them.
+	/// DORM_Initial ones are left untouched until their first wake, then they fall asleep as DORM_DormantAll.
+	/// Other interactables, pawns and actors which replicate movement are left as they are.
+	/// </summary>
+	UPROPERTY(Config)
+	bool bManageNetDormancy = true;
+	/// <summary>
+	/// Seconds without interactions after which a woken interactable becomes dormant again. Should cover a few net updates of the interactable.
+	/// </summary>
+	UPROPERTY(Config)
+	float DormancyQuietPeriod = 2.f;
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<AActor> Actor;
+		//Set for instances of UInteractableInstancedStaticMeshComponent of Actor
+		TWeakObjectPtr<UInteractableInstancedStaticMeshComponent> InstancedMesh;
+		int32 InstanceIndex = INDEX_NONE;
+		FBox Bounds;
+		FIntVector MinCell;
+		FIntVector MaxCell;
+		FDelegateHandle TransformUpdatedHandle;
+		int32 HistoryIndex = INDEX_NONE;
+		bool bDescriptorDirty = true;
+		//Prevents visiting the entry twice when it spans several cells
+		mutable uint32 QueryStamp = 0;
+	};
+
+	TSparseArray<FEntry> Entries;
+	//Stored apart from entries to keep spatial queries compact. Indices are the same as in Entries
+	TSparseArray<FInteractableDescriptor> Descriptors;
+	TMap<TObjectKey<AActor>, int32> EntryIndices;
+	/// <summary>
+	/// Owner of interactable instances. The owner itself has no entry.
+	/// </summary>
+	struct FInstanceOwner
+	{
+		TWeakObjectPtr<UInteractableInstancedStaticMeshComponent> Component;
+		// Entry index of every instance, INDEX_NONE for disabled ones
+		TArray<int32> EntryIndices;
+		FDelegateHandle TransformUpdatedHandle;
+	};
+	TMap<TObjectKey<AActor>, FInstanceOwner> InstanceOwners;
+	struct FCell
+	{
+		TArray<int32> EntryIndices;
+		//Value of Revision when an interactable in the cell has been added, removed or moved
+		uint64 Revision = 0;
+	};
+
+	TMap<FIntVector, FCell> Cells;
+	uint64 Revision = 0;
+	mutable uint32 QueryStamp = 0;
+
+	FDelegateHandle ActorSpawnedHandle;
+	FDelegateHandle LevelAddedHandle;
+
+	struct FHistorySample
+	{
+		float Time = 0.f;
+		FVector Center = FVector::ZeroVector;
+	};
+	/// <summary>
+	/// Ring buffer of bounds centers of a moving interactable. Exists only on server and only while the interactable moves or its samples can still be rewound to.
+	/// </summary>
+	struct FBoundsHistory
+	{
+		int32 EntryIndex = INDEX_NONE;
+		TArray<FHistorySample> Samples;
+		int32 NewestSample = INDEX_NONE;
+		float LastMoveTime = 0.f;
+		bool bMovedSinceSample = false;
+	};
+
+	TSparseArray<FBoundsHistory> Histories;
+	FTimerHandle HistorySampleTimerHandle;
+	bool bRecordHistory = false;
+
+	struct FDormancyState
+	{
+		int32 NumInteractions = 0;
+		float LastInteractionTime = 0.f;
+		bool bAwake = false;
+		// Restored when the interactable is unregistered
+		TEnumAsByte<ENetDormancy> OriginalDormancy = DORM_DormantAll;
+	};
+
+	TMap<TObjectKey<AActor>, FDormancyState> DormancyStates;
+	int32 NumAwakeInteractables = 0;
+	FTimerHandle DormancyTimerHandle;
+
+	bool ShouldManageNetDormancy(const AActor* Actor) const;
+	void StartManagingNetDormancy(AActor* Actor);
+	void StopManagingNetDormancy(AActor* Actor);
+	void UpdateNetDormancy();
+
+	void RecordMovement(int32 EntryIndex, const FVector& OldCenter);
+	void AddHistorySample(FBoundsHistory& History, float Time, const FVector& Center) const;
+	void SampleHistories();
+	FBox GetRewoundBounds(const FEntry& Entry, float Time) const;
+	float ClampRewindTime(float Time) const;
+
+	FIntVector GetCell(const FVector& Location) const;
+	static FBox CalculateBounds(const FEntry& Entry);
+	int32 FindEntryIndex(const FInteractableHandle& Handle) const;
+	void UpdateEntry(int32 EntryIndex);
+	void RemoveEntry(int32 EntryIndex);
+	void AddToCells(int32 EntryIndex);
+	void RemoveFromCells(int32 EntryIndex);
+	void MarkCellsChanged(const FIntVector& MinCell, const FIntVector& MaxCell);
+
+	void OnActorSpawned(AActor* Actor);
+	void OnLevelAdded(ULevel* Level, UWorld* World);
+	void OnRootTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+	UFUNCTION()
+	void OnActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+};
+//------------------------------------------------------------------------------------------------------------/UInteractionTargetingSubsystem/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Caches interaction targets of avatars. The query runs at most once per avatar per frame and every consumer (outlining cue, interaction ability) is served from the cache.
+/// Cached result is reused only while the camera stays at the pose it was computed for.
+/// </summary>
+UCLASS()
+class INTERACTIONSYSTEM_API UInteractionTargetingSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/// <summary>
+	/// Returns interaction target of the avatar. Runs a new query if there is no cached result not older than MaxFrameAge frames for the current camera pose and the same params.
+	/// </summary>
+	/// <param name="AvatarActor"></param>
+	/// <param name="Params"></param>
+	/// <param name="MaxFrameAge">0 accepts only a result of the current frame</param>
+	/// <returns></returns>
+	FInteractableHandle GetInteractionTarget(const AActor* AvatarActor, const FInteractionTargetingParams& Params, uint32 MaxFrameAge = 0);
+	/// <summary>
+	/// Drops the cached result of the avatar, so the next request runs a new query.
+	/// </summary>
+	/// <param name="AvatarActor"></param>
+	void InvalidateTarget(const AActor* AvatarActor);
+	/// <summary>
+	/// Starts an asynchronous query. Candidates are scored immediately, line of sight traces run off the game thread one after another, starting from the best candidate.
+	/// The result arrives through the delegate one or more frames later and is also stored in the cache, never inside this call, even when no trace is needed.
+	/// Requests for an avatar which already has a query with the same params in flight are merged into it.
+	/// </summary>
+	/// <param name="AvatarActor"></param>
+	/// <param name="Params"></param>
+	/// <param name="OnResolved"></param>
+	void RequestInteractionTargetAsync(const AActor* AvatarActor, const FInteractionTargetingParams& Params, FOnInteractionTargetResolved OnResolved);
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FCachedTarget
+	{
+		TWeakObjectPtr<const AActor> Avatar;
+		TWeakObjectPtr<const UCameraComponent> Camera;
+		FInteractableHandle Target;
+		FInteractionTargetingParams Params;
+		FTransform CameraTransform;
+		uint64 FrameNumber = 0;
+	};
+
+	struct FPendingAsyncQuery
+	{
+		TWeakObjectPtr<const AActor> Avatar;
+		FInteractionTargetingParams Params;
+		FTransform CameraTransform;
+		FVector Origin;
+		// Best first, the next one is traced only when the previous one is hidden
+		FRankedInteractionCandidates Candidates;
+		int32 CandidateIndex = 0;
+		uint64 FrameNumber = 0;
+		TArray<FOnInteractionTargetResolved> Callbacks;
+		// Set when no trace is needed, the query is resolved by the next tick
+		bool bResolved = false;
+		FInteractableHandle ResolvedTarget;
+	};
+
+	struct FDeferredResult
+	{
+		FOnInteractionTargetResolved Callback;
+		FInteractableHandle Target;
+		uint64 FrameNumber = 0;
+	};
+
+	TMap<TObjectKey<AActor>, FCachedTarget> CachedTargets;
+	TMap<TObjectKey<AActor>, FPendingAsyncQuery> PendingAsyncQueries;
+	TArray<FDeferredResult> DeferredResults;
+
+	void StartLineOfSightTrace(TObjectKey<AActor> AvatarKey, const FPendingAsyncQuery& Pending);
+	void OnAsyncTraceCompleted(TObjectKey<AActor> AvatarKey, FTraceDatum& TraceDatum);
+	void ResolveAsyncQuery(TObjectKey<AActor> AvatarKey, const FInteractableHandle& Target);
+	void DeferResult(FOnInteractionTargetResolved&& OnResolved, const FInteractableHandle& Target);
+};
+//------------------------------------------------------------------------------------------------------------/UInteractionArbiterSubsystem/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Decides on server which interaction requests are granted. Requests are queued and processed once per frame:
+/// targets of all requests are chosen first, with one query per avatar shared by its requests through the targeting cache, then requests for the same target are resolved together, closest instigator first,
+/// according to IInteractable::GetMaxConcurrentInteractors. Every player is rate-limited with a token bucket.
+/// </summary>
+UCLASS(config = Game)
+class INTERACTIONSYSTEM_API UInteractionArbiterSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/// <summary>
+	/// Queues the request until the end of the frame. Rate-limited requests are rejected immediately.
+	/// </summary>
+	/// <param name="Ability">Holds the slot of the target until ReleaseSlot</param>
+	/// <param name="AvatarActor"></param>
+	/// <param name="Player">Actor whose requests share the rate limit, usually the owner of the ability system component</param>
+	/// <param name="Target">Target chosen and validated before, or an empty handle to choose it with Params</param>
+	/// <param name="Params"></param>
+	/// <param name="OnArbitrated"></param>
+	void SubmitRequest(const UGAInteraction* Ability, const AActor* AvatarActor, const AActor* Player, const FInteractableHandle& Target, const FInteractionTargetingParams& Params, FOnInteractionArbitrated OnArbitrated);
+	/// <summary>
+	/// Frees the slot of the target which has been granted to the ability
+	/// </summary>
+	/// <param name="Ability"></param>
+	/// <param name="Target"></param>
+	void ReleaseSlot(const UGAInteraction* Ability, const FInteractableHandle& Target);
+	/// <summary>
+	/// Returns how many abilities are interacting with the target now
+	/// </summary>
+	int32 GetNumInteractors(const FInteractableHandle& Target) const;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/// <summary>
+	/// Requests per second restored to the bucket of every player
+	/// </summary>
+	UPROPERTY(Config)
+	float RequestsPerSecond = 5.f;
+	/// <summary>
+	/// Capacity of the bucket, how many requests a player can send at once
+	/// </summary>
+	UPROPERTY(Config)
+	float RequestBurst = 3.f;
+
+private:
+	struct FRequest
+	{
+		TWeakObjectPtr<const UGAInteraction> Ability;
+		TWeakObjectPtr<const AActor> Avatar;
+		FInteractableHandle Target;
+		bool bHasTarget = false;
+		FInteractionTargetingParams Params;
+		FOnInteractionArbitrated OnArbitrated;
+	};
+
+	struct FRequestBucket
+	{
+		float Tokens = 0.f;
+		double LastRefillTime = 0.0;
+	};
+
+	TArray<FRequest> PendingRequests;
+	TMap<FInteractableHandle, TArray<TWeakObjectPtr<const UGAInteraction>>> Interactors;
+	TMap<TObjectKey<AActor>, FRequestBucket> RequestBuckets;
+
+	bool ConsumeRequestToken(const AActor* Player);
+};
+//------------------------------------------------------------------------------------------------------------/UInteractionHoldComponent/------------------------------------------------------------------------------------------------------------
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnInteractionHoldersChanged, int32, InstanceIndex);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnInteractionHoldCompleted, int32 /*InstanceIndex*/, AActor* /*Executor*/);
+
+/// <summary>
+/// One instigator holding the interactable. Holders of the same instance share the progress, BaseProgress and BaseTime are the same in all of them.
+/// </summary>
+USTRUCT(BlueprintType)
+struct INTERACTIONSYSTEM_API FInteractionHolder : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	TWeakObjectPtr<AActor> Instigator;
+	/// <summary>
+	/// Index of the held instance, INDEX_NONE for the actor itself
+	/// </summary>
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	int32 InstanceIndex = INDEX_NONE;
+	/// <summary>
+	/// Server world time when the instigator has started holding
+	/// </summary>
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	float StartTime = 0.f;
+	/// <summary>
+	/// Hold duration of the target for a single instigator with contribution 1
+	/// </summary>
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	float Duration = 0.f;
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	float Contribution = 1.f;
+	/// <summary>
+	/// Shared progress at BaseTime. Rebased whenever a holder of the instance joins or leaves, between rebases progress grows linearly.
+	/// </summary>
+	UPROPERTY()
+	float BaseProgress = 0.f;
+	UPROPERTY()
+	float BaseTime = 0.f;
+
+	void PreReplicatedRemove(const struct FInteractionHolders& InArraySerializer);
+	void PostReplicatedAdd(const struct FInteractionHolders& InArraySerializer);
+	void PostReplicatedChange(const struct FInteractionHolders& InArraySerializer);
+};
+
+USTRUCT()
+struct INTERACTIONSYSTEM_API FInteractionHolders : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FInteractionHolder> Items;
+	// Set by the component which owns the array in PostInitProperties, after the properties of the archetype have been copied
+	UInteractionHoldComponent* Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FInteractionHolder, FInteractionHolders>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FInteractionHolders> : public TStructOpsTypeTraitsBase2<FInteractionHolders>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/// <summary>
+/// Shares hold progress of the interactable with all players. Add it to interactables whose holds must be visible to others or cooperative, e.g. revive or hacking.
+/// Only joins and leaves of holders are replicated, with push model and fast array delta serialization. Clients interpolate the progress locally.
+/// Holds of several instigators on the same target are combined: progress speed is the sum of Contribution / Duration of all holders.
+/// The interaction is executed once, by the holder who has started first. MaxConcurrentInteractors of the interactable must allow several holders.
+/// </summary>
+UCLASS(ClassGroup = Interaction, meta = (BlueprintSpawnableComponent))
+class INTERACTIONSYSTEM_API UInteractionHoldComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UInteractionHoldComponent();
+
+	virtual void PostInitProperties() override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/// <summary>
+	/// Server only. Adds the holder and rebases the shared progress of the instance.
+	/// </summary>
+	/// <param name="Instigator"></param>
+	/// <param name="InstanceIndex"></param>
+	/// <param name="Duration">Hold duration for a single instigator with contribution 1</param>
+	/// <param name="Contribution"></param>
+	/// <param name="TimeCredit">Time the instigator has already held, e.g. on the predicting client before the request has arrived</param>
+	void AddHolder(AActor* Instigator, int32 InstanceIndex, float Duration, float Contribution, float TimeCredit = 0.f);
+	/// <summary>
+	/// Server only. Removes the holder, progress made so far stays while other holders remain.
+	/// </summary>
+	void RemoveHolder(AActor* Instigator, int32 InstanceIndex);
+
+	/// <summary>
+	/// Returns combined progress of the instance from 0 to 1, interpolated locally on clients. 0 if nobody holds it.
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	float GetHoldProgress(int32 InstanceIndex = -1) const;
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	int32 GetNumHolders(int32 InstanceIndex = -1) const;
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	const TArray<FInteractionHolder>& GetHolders() const { return Holders.Items; }
+
+	/// <summary>
+	/// Called on server and clients when a holder has joined or left, or the progress has been rebased
+	/// </summary>
+	UPROPERTY(BlueprintAssignable, Category = Interaction)
+	FOnInteractionHoldersChanged OnHoldersChanged;
+	/// <summary>
+	/// Server only. Called when the combined progress has reached 1. Holders are removed before it is called.
+	/// </summary>
+	FOnInteractionHoldCompleted OnHoldCompleted;
+
+private:
+	UPROPERTY(Replicated)
+	FInteractionHolders Holders;
+
+	// One-shot completion timer of every held instance, rescheduled on every rebase
+	TMap<int32, FTimerHandle> CompletionTimers;
+
+	float GetHoldProgressAt(int32 InstanceIndex, float Time) const;
+	float GetProgressRate(int32 InstanceIndex) const;
+	/// <summary>
+	/// Stores the progress at Time as the base of all holders of the instance
+	/// </summary>
+	void Rebase(int32 InstanceIndex, float Time);
+	void ScheduleCompletion(int32 InstanceIndex, float Time);
+	void CompleteHold(int32 InstanceIndex);
+	void MarkHoldersDirty();
 };
 //------------------------------------------------------------------------------------------------------------/UGAInteraction/------------------------------------------------------------------------------------------------------------
 UCLASS(Blueprintable)
 class INTERACTIONSYSTEM_API UGAInteraction : public UGameplayAbility
 {
 	GENERATED_BODY()
+	friend struct FInteractionBenchmarkAccess;
 
 	typedef UGameplayAbility Super;
 
 public:
+	/// <summary>
+	/// NetExecutionPolicy can be changed to LocalPredicted in blueprint defaults. Then the client interacts immediately and the server confirms or cancels it.
+	/// </summary>
 	UGAInteraction()
 	{
 		NetExecutionPolicy = EGameplayAbilityNetExecutionPolicy::ServerInitiated;
@@ -60,31 +958,174 @@ public:
 	}
 
 	virtual void ActivateAbility(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, const FGameplayEventData* TriggerEventData) override;
+	virtual void EndAbility(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, bool bReplicateEndAbility, bool bWasCancelled) override;
 	/// <summary>
-	/// Returns the actor that the camera is pointing at, which implements the IInteractable interface and is within reach.
+	/// Returns the interactable actor or instance that the camera is pointing at and which is within reach.
 	/// </summary>
 	/// <param name="AvatarActor"></param>
+	/// <param name="Params"></param>
 	/// <returns></returns>
-	static AActor* GetInteractionTarget(const AActor* AvatarActor);
+	/// <param name="RewindTime">Server world time for which moving interactables are rewound, e.g. when the client has aimed</param>
+	static FInteractableHandle GetInteractionTarget(const AActor* AvatarActor, const FInteractionTargetingParams& Params = FInteractionTargetingParams(), TOptional<float> RewindTime = TOptional<float>());
+	/// <summary>
+	/// Same as GetInteractionTarget, but served from UInteractionTargetingSubsystem so the query runs at most once per avatar per frame.
+	/// </summary>
+	/// <param name="AvatarActor"></param>
+	/// <param name="Params"></param>
+	/// <param name="MaxFrameAge">How many frames old the cached result is allowed to be. 0 accepts only a result of the current frame.</param>
+	/// <returns></returns>
+	static FInteractableHandle GetCachedInteractionTarget(const AActor* AvatarActor, const FInteractionTargetingParams& Params = FInteractionTargetingParams(), uint32 MaxFrameAge = 0);
+	/// <summary>
+	/// Returns location and direction of the avatar`s camera. Returns false if the avatar has no camera.
+	/// </summary>
+	static bool GetInteractionView(const AActor* AvatarActor, FVector& OutOrigin, FVector& OutDirection);
+	/// <summary>
+	/// Gathers interactables around the view of the avatar, scores them and returns the best ones, best first, without line of sight checks.
+	/// Returns up to MaxLineOfSightChecks candidates if line of sight is required, otherwise only the best one. Returns false if the avatar has no camera.
+	/// </summary>
+	static bool RankInteractionCandidates(const AActor* AvatarActor, const FInteractionTargetingParams& Params, FVector& OutOrigin, FRankedInteractionCandidates& OutRanked, TOptional<float> RewindTime = TOptional<float>());
+	/// <summary>
+	/// Scores padded candidates four at a time. Candidates outside the widened view cone or farther than MaxDistance get TNumericLimits<float>::Lowest().
+	/// </summary>
+	static void ScoreInteractionCandidates(const FInteractionCandidates& Candidates, const FVector& Direction, const FInteractionTargetingParams& Params, TArray<float>& OutScores);
+	/// <summary>
+	/// Returns true if nothing but the candidate itself blocks the visibility trace from the origin to the candidate
+	/// </summary>
+	static bool HasLineOfSight(const AActor* AvatarActor, const FVector& Origin, const FInteractionCandidate& Candidate);
+	/// <summary>
+	/// Returns true if the hit is on the target, including the instance index for instances
+	/// </summary>
+	static bool IsHitOnTarget(const FHitResult& HitResult, const FInteractableHandle& Target);
+	/// <summary>
+	/// Returns targeting params of the interaction ability granted to the avatar, or default params if there is none
+	/// </summary>
+	static const FInteractionTargetingParams& GetTargetingParams(const AActor* AvatarActor);
+	/// <summary>
+	/// Returns world time of the server, which is the same on server and clients up to the clock sync error
+	/// </summary>
+	static float GetServerWorldTime(const UWorld* World);
+
 protected:
 	/// <summary>
 	/// Called interaction only on server. You must create RPC or replicate variables in target to inform clients about the interaction result.
 	/// </summary>
 	/// <param name="ActivationInfo"></param>
 	void ExecuteInteraction(const FGameplayAbilityActivationInfo* ActivationInfo);
+	/// <summary>
+	/// Starts the interaction with InteractionTarget according to its interaction type
+	/// </summary>
+	void StartInteraction(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, const FGameplayEventData* TriggerEventData);
+	/// <summary>
+	/// Returns true if the target which the predicting client has chosen can be interacted with.
+	/// Moving interactables are rewound to the time when the client has aimed.
+	/// </summary>
+	/// <param name="ClientTarget"></param>
+	/// <param name="ClientTimestamp">Server world time on the client when it has chosen the target</param>
+	/// <returns></returns>
+	virtual bool IsValidClientTarget(const FInteractableHandle& ClientTarget, float ClientTimestamp) const;
+	/// <summary>
+	/// Returns true if the target bounds are inside the view cone of the avatar widened by CandidateRadius + Tolerance.
+	/// </summary>
+	static bool IsTargetInReach(const AActor* AvatarActor, const FInteractableHandle& Target, const FInteractionTargetingParams& Params, float Tolerance, TOptional<float> RewindTime = TOptional<float>());
+
+	/// <summary>
+	/// How the target is chosen. Also used by the outlining cue of the avatar which has this ability.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = Interaction)
+	FInteractionTargetingParams TargetingParams;
+	/// <summary>
+	/// Re-validates the Hold target with asynchronous traces. Authoritative check in ActivateAbility stays synchronous.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = Interaction)
+	bool bUseAsyncTargeting = false;
+	/// <summary>
+	/// How often the Hold target is re-validated, in seconds. 0 disables re-validation.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = Interaction, meta = (ClampMin = "0"))
+	float HoldRevalidationInterval = 0.2f;
+	/// <summary>
+	/// LocalPredicted only. How much earlier than the server the client is allowed to have started holding, in seconds.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = Interaction, meta = (ClampMin = "0"))
+	float MaxHoldClockSkew = 0.25f;
+	/// <summary>
+	/// LocalPredicted only. Extra distance to the view cone allowed for the target chosen by the client.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = Interaction, meta = (ClampMin = "0"))
+	float ClientTargetTolerance = 50.f;
+	/// <summary>
+	/// Hold speed of this instigator on targets with UInteractionHoldComponent, where holds of several instigators are combined. 1 is the normal speed.
+	/// Own hold of the instigator takes HoldDuration / HoldContribution, other holders make it shorter.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = Interaction, meta = (ClampMin = "0"))
+	float HoldContribution = 1.f;
 
 private:
-	AActor* TargetActor;
+	FInteractableHandle InteractionTarget;
 	AActor* AvatarActor;
 	/// <summary>
 	/// Valid only when locally controlled. Can be nullptr.
 	/// </summary>
-	UInteractionLocalPlayerSubsystem* InteractionSubsystem;
+	UInteractionLocalPlayerSubsystem* InteractionSubsystem = nullptr;
 
 	//Uses in interaction implementation
 	FTimerHandle HoldTimerHandle;
+	FTimerHandle HoldValidationTimerHandle;
 	float HoldDuration;
-	float HoldingTime = 0.f;
+	float HoldStartTime = 0.f;
+	UPROPERTY()
+	UAbilityTask_WaitInputRelease* WaitInputReleaseTask = nullptr;
+
+	//-----Prediction------
+	/// <summary>
+	/// Set on the predicting client after PredictInteract has been called, until the server ends the ability
+	/// </summary>
+	bool bInteractionPredicted = false;
+	/// <summary>
+	/// Hold time already elapsed on the predicting client when its request has arrived. Valid only on server.
+	/// </summary>
+	float HoldTimeCredit = 0.f;
+	FDelegateHandle ClientTargetDataDelegateHandle;
+
+	void SendTargetToServer();
+	void OnClientTargetDataReceived(const FGameplayAbilityTargetDataHandle& TargetDataHandle, FGameplayTag ApplicationTag);
+	void OnActivationRejected();
+	void RollbackPredictedInteraction();
+	/// <summary>
+	/// True on the client of a locally predicted ability. It must not end the ability after the interaction, the server ends it.
+	/// </summary>
+	bool IsWaitingForServerEnd(const FGameplayAbilityActivationInfo& ActivationInfo) const;
+
+	//-----Arbitration------
+	/// <summary>
+	/// Set on server while the ability holds a slot of InteractionTarget in UInteractionArbiterSubsystem
+	/// </summary>
+	bool bHoldsArbiterSlot = false;
+	FInteractableHandle ArbiterSlotTarget;
+	/// <summary>
+	/// Changed by every request and by EndAbility, so a result which arrives for an older activation is ignored
+	/// </summary>
+	uint32 ArbitrationRequestId = 0;
+	/// <summary>
+	/// Interactable kept awake by this activation on server, see UInteractableRegistrySubsystem::BeginNetInteraction
+	/// </summary>
+	TWeakObjectPtr<AActor> NetInteractionActor;
+
+	/// <summary>
+	/// Returns false if the server has no arbiter, then the request is handled immediately
+	/// </summary>
+	bool SubmitToArbiter(const FInteractableHandle& PresetTarget);
+	void OnArbitrated(EInteractionArbitrationResult Result, const FInteractableHandle& GrantedTarget, uint32 RequestId);
+
+	//-----Shared hold------
+	/// <summary>
+	/// Set on server while the hold is combined with holds of other instigators in UInteractionHoldComponent of the target
+	/// </summary>
+	bool bSharedHold = false;
+	TWeakObjectPtr<UInteractionHoldComponent> SharedHoldComponent;
+	FDelegateHandle SharedHoldCompletedHandle;
+
+	void OnSharedHoldCompleted(int32 InstanceIndex, AActor* Executor);
 
 	//-----Hold handlers------
 	/// <summary>
@@ -93,6 +1134,23 @@ private:
 	/// <param name="TimeHeld"></param>
 	UFUNCTION() void InterruptHolding(float TimeHeld);
 	/// <summary>
+	/// Callback of asynchronous target re-validation
+	/// </summary>
+	/// <param name="NewTarget"></param>
+	void OnHoldTargetResolved(const FInteractableHandle& NewTarget);
+	/// <summary>
+	/// Called by the one-shot hold timer when HoldDuration has elapsed since HoldStartTime
+	/// </summary>
+	void FinishHolding();
+	/// <summary>
+	/// Checks at HoldRevalidationInterval that the player still aims at the hold target
+	/// </summary>
+	void ValidateHoldTarget();
+	/// <summary>
+	/// Clears hold timers and resets the progress bar
+	/// </summary>
+	void StopHolding();
+	/// <summary>
 	/// Handles the implementation of holding an ability. Called by ActivateAbility if the interaction type is Hold.
 	/// </summary>
 	/// <param name="Handle"></param>
@@ -101,6 +1159,73 @@ private:
 	/// <param name="TriggerEventData"></param>
 	void HoldImplementanion(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo, const FGameplayAbilityActivationInfo ActivationInfo, const FGameplayEventData* TriggerEventData);
 };
+//------------------------------------------------------------------------------------------------------------/UInteractionOutlineSubsystem/------------------------------------------------------------------------------------------------------------
+/// <summary>
+/// Outline layer of an interactable. Value is the custom depth stencil value, so the post process material can draw every layer with its own color.
+/// </summary>
+UENUM(BlueprintType)
+enum class EInteractionOutlineLayer : uint8
+{
+	None = 0 UMETA(Hidden),
+	Focused = 1,
+	InRange = 2,
+	Teammate = 3,
+};
+
+/// <summary>
+/// Keeps the set of outlined interactables of the world and applies changes of custom depth in one batch at the end of the frame.
+/// Only meshes whose stencil value has changed are touched, so a mesh shared by the old and the new target doesn't mark its render state dirty.
+/// Every requester adds and removes its own requests, so several local players can outline the same target.
+/// A mesh in several layers gets the one with the highest priority: Focused, Teammate, InRange.
+/// </summary>
+UCLASS()
+class INTERACTIONSYSTEM_API UInteractionOutlineSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+	friend struct FInteractionBenchmarkAccess;
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// <summary>
+	/// Adds or removes one outline request of the target in the layer. Requests of destroyed targets are dropped automatically.
+	/// </summary>
+	/// <param name="Target"></param>
+	/// <param name="Layer"></param>
+	/// <param name="bOutlined"></param>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void SetOutlined(const FInteractableHandle& Target, EInteractionOutlineLayer Layer, bool bOutlined);
+	/// <summary>
+	/// Recomputes outlined meshes at the end of the frame. Must be called when meshes of an outlined interactable have changed.
+	/// </summary>
+	UFUNCTION(BlueprintCallable, Category = Interaction)
+	void MarkDirty() { bDirty = true; }
+
+	int32 GetNumOutlinedMeshes() const { return AppliedMeshes.Num(); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	static constexpr int32 NumLayers = 3;
+	struct FOutlineRequests
+	{
+		// Number of requests in every layer, indexed by stencil value - 1
+		int32 Counts[NumLayers] = {};
+	};
+
+	TMap<FInteractableHandle, FOutlineRequests> Requests;
+	TMap<TWeakObjectPtr<UMeshComponent>, EInteractionOutlineLayer> AppliedMeshes;
+	TMap<TPair<TWeakObjectPtr<UInteractableInstancedStaticMeshComponent>, int32>, EInteractionOutlineLayer> AppliedInstances;
+	bool bDirty = false;
+	FDelegateHandle PostActorTickHandle;
+
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void ApplyOutlines();
+	static EInteractionOutlineLayer GetTopLayer(const FOutlineRequests& LayerRequests);
+	static int32 GetLayerPriority(EInteractionOutlineLayer Layer);
+};
 //------------------------------------------------------------------------------------------------------------/AGC_InteractableOutlinig/------------------------------------------------------------------------------------------------------------
 //For corerect work player`s camera must have corresponding postprocess material. You can setup it in config file
 //PostprocessOutliningMaterialPath=
@@ -108,13 +1233,14 @@ UCLASS(Blueprintable, Category = "GameplayCueNotify")
 class INTERACTIONSYSTEM_API AGC_InteractableOutlinig : public AGameplayCueNotify_Actor
 {
 	GENERATED_BODY()
+	friend struct FInteractionBenchmarkAccess;
 
 public:
 	AGC_InteractableOutlinig()
 	{
 		PrimaryActorTick.bCanEverTick = true;
 		PrimaryActorTick.bStartWithTickEnabled = true;
-		PrimaryActorTick.TickInterval = 0.1f; // Adjust as needed for performance
+		PrimaryActorTick.TickInterval = 0.1f; // Initial value, adapted to the view speed between MinTickInterval and MaxTickInterval
 		bAutoDestroyOnRemove = true;
 	}
 	/// <summary>
@@ -127,8 +1253,51 @@ public:
 protected:
 	UPROPERTY(BlueprintReadOnly)
 	UInteractionLocalPlayerSubsystem* InteractionSubsystem = nullptr;
+	/// <summary>
+	/// Uses asynchronous traces for outlining. Target is updated one frame after the query.
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = Interaction)
+	bool bUseAsyncTargeting = false;
+
+	//-----Adaptive tick------
+	/// <summary>
+	/// Query is skipped while the camera has moved less than this distance since the last query and interactables around haven't changed
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Adaptive Tick", meta = (ClampMin = "0"))
+	float MinCameraMoveDistance = 2.f;
+	/// <summary>
+	/// Query is skipped while the camera has rotated less than this angle in degrees since the last query and interactables around haven't changed
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Adaptive Tick", meta = (ClampMin = "0"))
+	float MinCameraRotationDegrees = 0.5f;
+	/// <summary>
+	/// Query runs at least this often, in seconds, to catch changes of non-interactable geometry
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Adaptive Tick", meta = (ClampMin = "0"))
+	float MaxSkippedQueryTime = 0.5f;
+	/// <summary>
+	/// Tick interval while the view is moving fast
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Adaptive Tick", meta = (ClampMin = "0"))
+	float MinTickInterval = 0.02f;
+	/// <summary>
+	/// Tick interval while the view is still
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Adaptive Tick", meta = (ClampMin = "0"))
+	float MaxTickInterval = 0.1f;
+	/// <summary>
+	/// Camera rotation speed in degrees per second at which MinTickInterval is reached
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Adaptive Tick", meta = (ClampMin = "1"))
+	float FastViewAngularSpeed = 180.f;
+	/// <summary>
+	/// Camera movement speed at which MinTickInterval is reached
+	/// </summary>
+	UPROPERTY(EditDefaultsOnly, Category = "Interaction|Adaptive Tick", meta = (ClampMin = "1"))
+	float FastViewLinearSpeed = 1000.f;
 
 	virtual void HandleGameplayCue(AActor* MyTarget, EGameplayCueEvent::Type EventType, const FGameplayCueParameters& Parameters) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void OnTargetChanged_Implementation(AActor* OldTarget, AActor* NewTarget);
 
 	UFUNCTION(BlueprintCallable)
@@ -138,7 +1307,27 @@ protected:
 	void OnTargetChanged(AActor* OldTarget, AActor* NewTarget);
 
 private:
-	AActor* CurrentTarget = nullptr;
+	// Weak, so a destroyed target leaves no dangling pointer
+	FInteractableHandle CurrentTarget;
+
+	void SetCurrentTarget(const FInteractableHandle& NewTarget);
+	/// <summary>
+	/// Adapts tick interval to the view speed and returns false if the target can't have changed since the last query
+	/// </summary>
+	bool ShouldQueryTarget(float DeltaTime);
+
+	// Taken from the interaction ability of the instigator once it is granted
+	FInteractionTargetingParams TargetingParams;
+	bool bTargetingParamsResolved = false;
+
+	FVector LastTickTraceStart = FVector::ZeroVector;
+	FVector LastTickTraceDirection = FVector::ForwardVector;
+	bool bHasLastTickPose = false;
+	FVector LastQueryTraceStart = FVector::ZeroVector;
+	FVector LastQueryTraceDirection = FVector::ForwardVector;
+	uint64 LastQueryRevision = 0;
+	float LastQueryTime = 0.f;
+	bool bHasLastQueryPose = false;
 
 };
 //------------------------------------------------------------------------------------------------------------/UInteractionWidget/------------------------------------------------------------------------------------------------------------
@@ -150,8 +1339,39 @@ class INTERACTIONSYSTEM_API UInteractionWidget : public UUserWidget
 public:
 	UFUNCTION(BlueprintCallable, BlueprintImplementableEvent)
 	void TargetChanged(AActor* OldTarget, AActor* NewTarget);
+	/// <summary>
+	/// Current target including the instance index. Set before TargetChanged is called.
+	/// </summary>
+	UPROPERTY(BlueprintReadOnly, Category = Interaction)
+	FInteractableHandle TargetHandle;
 	UFUNCTION(BlueprintCallable, BlueprintImplementableEvent)
 	void UpdateProgressBar(float Percent);
+	/// <summary>
+	/// Starts local interpolation of the progress bar. UpdateProgressBar is called every widget tick with progress computed from the timestamp.
+	/// </summary>
+	/// <param name="StartTime">World time when holding has started</param>
+	/// <param name="Duration"></param>
+	UFUNCTION(BlueprintCallable)
+	void StartHoldProgress(float StartTime, float Duration);
+	UFUNCTION(BlueprintCallable)
+	void StopHoldProgress();
+	/// <summary>
+	/// Progress bar shows the combined progress of the component when it is ahead of the own hold, e.g. with other holders
+	/// </summary>
+	/// <param name="HoldComponent"></param>
+	/// <param name="InstanceIndex"></param>
+	UFUNCTION(BlueprintCallable)
+	void SetSharedHoldProgress(UInteractionHoldComponent* HoldComponent, int32 InstanceIndex);
+
+protected:
+	virtual void NativeTick(const FGeometry& MyGeometry, float InDeltaTime) override;
+
+private:
+	float HoldStartTime = 0.f;
+	float HoldDuration = 0.f;
+	bool bHoldInProgress = false;
+	TWeakObjectPtr<UInteractionHoldComponent> SharedHoldComponent;
+	int32 SharedHoldInstance = INDEX_NONE;
 };
 //------------------------------------------------------------------------------------------------------------/UInteractionLocalPlayerSubsystem/------------------------------------------------------------------------------------------------------------
 UCLASS(BlueprintType,config=Game)
@@ -160,8 +1380,15 @@ class INTERACTIONSYSTEM_API UInteractionLocalPlayerSubsystem : public ULocalPlay
 	GENERATED_BODY()
 
 public:
+	/// <summary>
+	/// Starts asynchronous loading of the widget class and the outlining material
+	/// </summary>
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
 	/// <summary>
 	/// Returns the interaction widget instance. Creates it if it doesn't exist.
+	/// Waits for the widget class if it is still loading.
 	/// </summary>
 	/// <returns></returns>
 	UFUNCTION(BlueprintCallable)
@@ -180,4 +1407,20 @@ protected:
 private:
 	UPROPERTY()
 	UInteractionWidget* InteractionWidget;
+
+	//-----Preloading------
+	TSharedPtr<FStreamableHandle> WidgetClassHandle;
+	TSharedPtr<FStreamableHandle> OutliningMaterialHandle;
+	/// <summary>
+	/// Pawn which was possessed before the outlining material has been loaded
+	/// </summary>
+	TWeakObjectPtr<APawn> PendingOutliningPawn;
+
+	void OnWidgetClassLoaded();
+	void OnOutliningMaterialLoaded();
+	/// <summary>
+	/// Creates the widget if its class is loaded and the player has a world
+	/// </summary>
+	void TryCreateWidget();
+	void ApplyOutliningMaterial(APawn* Pawn, UMaterialInterface* Material) const;
 };